@@ -0,0 +1,69 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Reader of the columnar binary file written with --binFileName
+# Usage: python read_wifi_bin.py <file.bin> [column] [slice]
+
+# Import
+import numpy as np
+import sys
+
+kinds = ['init', 'update', 'final']
+dtypes = {'i': '<i4', 'I': '<u4', 'd': '<f8'}
+
+
+# Function to read the header of the file
+def read_header(data):
+    if data[0:4].tostring() != b'WSKB':
+        raise ValueError('Not a binary KPI file')
+    version, nScalars, nColumns = np.frombuffer(data, '<u4', 3, 4)
+    fields = []
+    offset = 16
+    for k in range(nScalars + nColumns):
+        name = data[offset:offset+16].tostring().rstrip(b'\0').decode()
+        fields.append((name, dtypes[chr(data[offset+16])]))
+        offset += 20
+    return version, fields[:nScalars], fields[nScalars:], offset
+
+
+# Function to index the chunks of the file
+# Returns one dict of scalars per chunk and the columns as arrays (views into the file)
+def read_chunks(fileName):
+    data = np.memmap(fileName, np.uint8, 'r')
+    version, scalars, columns, offset = read_header(data)
+    chunks = []
+    while offset < len(data):
+        if data[offset:offset+4].tostring() != b'CHNK':
+            raise ValueError('Corrupted chunk at byte %d' % offset)
+        size = int(np.frombuffer(data, '<u4', 1, offset+4)[0])
+        pos = offset + 8
+        chunk = {}
+        for name, dtype in scalars:
+            chunk[name] = np.frombuffer(data, dtype, 1, pos)[0]
+            pos += np.dtype(dtype).itemsize
+        nSta = int(chunk['nStaA'] + chunk['nStaB'] + chunk['nStaC'])
+        for name, dtype in columns:
+            chunk[name] = np.frombuffer(data, dtype, nSta, pos)
+            pos += nSta * np.dtype(dtype).itemsize
+        chunks.append(chunk)
+        offset += 8 + size
+    return chunks
+
+
+# Function to get the stations of one slice ('A', 'B' or 'C') from a column of a chunk
+def slice_column(chunk, column, sliceN):
+    start = {'A': 0, 'B': chunk['nStaA'], 'C': chunk['nStaA'] + chunk['nStaB']}[sliceN]
+    return chunk[column][start:start + chunk['nSta' + sliceN]]
+
+
+if __name__ == '__main__':
+    chunks = read_chunks(sys.argv[1])
+    column = sys.argv[2] if len(sys.argv) > 2 else 'probErr'
+    sliceN = sys.argv[3] if len(sys.argv) > 3 else 'A'
+    for chunk in chunks:
+        values = slice_column(chunk, column, sliceN)
+        print('run %d seed %d %s t=%.1f s: mean %s = %g' % (chunk['runId'], chunk['seed'], kinds[chunk['kind']],
+              chunk['time'], column, np.mean(values) if len(values) else float('nan')))
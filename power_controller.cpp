@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * Example of slice controller built as a shared library: it keeps the initial configuration of the
+ * slices and adapts only the tx power of slice B to the Pe of its STAs on the last control window.
+ * The tx power is raised by step when more than offMax of the STAs B exceed probErrMax, and lowered
+ * by step when none does.
+ *
+ * The source has extension .cpp so that waf does not build it as an ns-3 script. Build it with
+ *
+ *   g++ -std=c++11 -O2 -shared -fPIC -I scratch -o libpower_controller.so scratch/power_controller.cpp
+ *
+ * and select it with
+ *
+ *   ./waf --run "wifi_dynamic --controller=./libpower_controller.so --controllerArgs=step=2,probErrMax=0.02"
+ *
+ */
+
+#include "slice_controller.h"
+#include <sstream>
+#include <string>
+#include <iostream>
+
+class PowerController : public SliceController
+{
+public:
+  PowerController (const char* args);
+  virtual void Initialize (const KpiSnapshot& kpi, SliceConfig config[3]);
+  virtual void Update (const KpiSnapshot& kpi, SliceConfig config[3]);
+
+private:
+  int step = 1;             // dB
+  double probErrMax = 0.02; // max Pe of a STA B
+  double offMax = 0.1;      // max fraction of STAs B above probErrMax
+  int txPowerMin = 0;       // dBm
+  int txPowerMax = 20;      // dBm
+};
+
+
+// function to parse the arguments of the controller (name=value ..., separated by spaces or commas)
+PowerController::PowerController (const char* args)
+{
+  std::string list (args);
+  for (std::size_t i = 0; i < list.size (); i++)
+  {
+    if (list[i] == ',') list[i] = ' ';
+  }
+  std::istringstream tokens (list);
+  std::string token;
+  while (tokens >> token)
+  {
+    std::size_t equal = token.find ('=');
+    std::string name = token.substr (0, equal);
+    std::istringstream value (equal == std::string::npos ? "" : token.substr (equal + 1));
+    if (name == "step") value >> step;
+    else if (name == "probErrMax") value >> probErrMax;
+    else if (name == "offMax") value >> offMax;
+    else if (name == "txPowerMin") value >> txPowerMin;
+    else if (name == "txPowerMax") value >> txPowerMax;
+    else std::cout << "Unknown argument of the power controller: " << token << std::endl;
+  }
+}
+
+
+void PowerController::Initialize (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  // The initial configuration of the script is kept
+}
+
+
+void PowerController::Update (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  int nOff = 0;
+  for (int i = 0; i < kpi.nSta[1]; i++)
+  {
+    if (kpi.probErr[0][kpi.nSta[0]+i] > probErrMax) nOff++;
+  }
+  if (nOff > offMax*kpi.nSta[1]) config[1].txPower += step;
+  else if (nOff == 0) config[1].txPower -= step;
+  if (config[1].txPower > txPowerMax) config[1].txPower = txPowerMax;
+  if (config[1].txPower < txPowerMin) config[1].txPower = txPowerMin;
+}
+
+
+extern "C" SliceController* CreateSliceController (const char* args)
+{
+  return new PowerController (args);
+}
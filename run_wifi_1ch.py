@@ -6,12 +6,14 @@
 
 # Import
 from datetime import datetime
-import subprocess
+import multiprocessing
+import wifi_cache
 import csv
 
 # Options
 num_scenarios = 1           # how many scenarios are simulated
 num_seeds = 20              # how many times each scenario is simulated
+num_workers = multiprocessing.cpu_count() # (scenario, seed range) jobs simulated in parallel
 notes = "6-100-2"           # notes to be written in the .csv file
 ns3_script = "wifi_1ch"     # ns3 script to be launched
 
@@ -27,26 +29,26 @@ def main():
     print
     arg_list = []
     for i in range(num_scenarios):
-        for j in range(num_seeds):
-            args = {}
-            args["simulationTime"] = 15
-            args["seed"] = j + 1
-            args["csvFileName"] = csv_file_ns3
-            args["band"] = "AX_5"
-            args["phyModel"] = "spectrum"
-            args["constantMcs"] = 1
-            args["channelNumber"] = 50
-            args["channelWidth"] = 160
-            args["mcs"] = 5
-            args["gi"] = 1600
-            args["txPower"] = 20
-            #args["dataRateA"] = "xMb/s" to be set in the ns3 script
-            #args["dataRateB"] = "xKb/s" to be set in the ns3 script
-            #args["dataRateC"] = "xMb/s" to be set in the ns3 script
-            args["nStaA"] = 6
-            args["nStaB"] = 100
-            args["nStaC"] = 2
-            arg_list.append(args)
+        args = {}
+        args["simulationTime"] = 15
+        args["seed"] = 1
+        args["lastSeed"] = num_seeds # the seeds are split into ranges run on the pool
+        args["csvFileName"] = csv_file_ns3
+        args["band"] = "AX_5"
+        args["phyModel"] = "spectrum"
+        args["constantMcs"] = 1
+        args["channelNumber"] = 50
+        args["channelWidth"] = 160
+        args["mcs"] = 5
+        args["gi"] = 1600
+        args["txPower"] = 20
+        #args["dataRateA"] = "xMb/s" to be set in the ns3 script
+        #args["dataRateB"] = "xKb/s" to be set in the ns3 script
+        #args["dataRateC"] = "xMb/s" to be set in the ns3 script
+        args["nStaA"] = 6
+        args["nStaB"] = 100
+        args["nStaC"] = 2
+        arg_list.append(args)
     with open(csv_file_py, 'w') as file:
         writer = csv.writer(file)
         writer.writerow(["scenarios", num_scenarios])
@@ -54,61 +56,7 @@ def main():
         writer.writerow(["notes", ns3ScriptName + ". " + notes])
         writer.writerow(["arg_list[0]", arg_list[0]])
         writer.writerow(["arg_list[" + str(len(arg_list)-1) + "]", arg_list[len(arg_list)-1]])
-    for i in range(0, len(arg_list)):
-        simulate(arg_list[i])
-        print
-
-
-def get_arguments(arg):
-    atribute_names = [
-    	" --simulationTime=",
-    	" --seed=",
-    	" --csvFileName=",
-    	" --band=",
-    	" --phyModel=",
-        " --constantMcs=",
-    	" --channelNumber=",
-        " --channelWidth=",
-        " --mcs=",
-        " --gi=",
-        " --txPower=",
-        #" --dataRateA=",
-        #" --dataRateB=",
-        #" --dataRateC=",
-        " --nStaA=",
-        " --nStaB=",
-        " --nStaC="
-        ]
-    atribute_values = [
-    	str(arg["simulationTime"]),
-    	str(arg["seed"]),
-    	str(arg["csvFileName"]),
-    	str(arg["band"]),
-    	str(arg["phyModel"]),
-        str(arg["constantMcs"]),
-    	str(arg["channelNumber"]),
-    	str(arg["channelWidth"]),
-        str(arg["mcs"]),
-        str(arg["gi"]),
-        str(arg["txPower"]),
-        #str(arg["dataRateA"]),
-        #str(arg["dataRateB"]),
-        #str(arg["dataRateC"]),
-        str(arg["nStaA"]),
-        str(arg["nStaB"]),
-        str(arg["nStaC"])
-        ]
-    arguments = ""
-    for s in range(0, len(atribute_names)):
-        arguments += atribute_names[s]
-        arguments += atribute_values[s]
-    return arguments
-
-
-def simulate(arg):
-    arguments = get_arguments(arg)
-    print "Calling the ns3 script '" + ns3_script + ".cc'"
-    subprocess.call('(cd ..; ./waf --run "' + ns3_script + arguments+ '")', shell=True)
+    wifi_cache.simulate_pool(ns3_script, arg_list, csv_file_py, num_workers)
 
 
 if __name__ == "__main__":
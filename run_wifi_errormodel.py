@@ -0,0 +1,90 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Validation of the table error rate model (errorModel=table) against the Nist model
+# The reference scenarios of the csv folder (station mixes A-B-C) are simulated with both models
+# and the same seeds, and the deviation of the mean of every per-slice KPI is reported.
+
+# Import
+from datetime import datetime
+import multiprocessing
+import wifi_cache
+import run_wifi_seq
+import csv
+
+# Options
+num_seeds = 20              # how many times each scenario is simulated with each model
+num_workers = multiprocessing.cpu_count() # (scenario, seed range) jobs simulated in parallel
+scenarios = [[2, 100, 6], [4, 100, 4], [6, 100, 2]] # nStaA, nStaB, nStaC of the csv/ reference files
+ns3_script = "wifi_dynamic" # ns3 script to be launched
+
+timestamp = datetime.now().strftime('%Y-%m-%d_%H:%M:%S')
+filebase = "/testfile_" + timestamp
+csv_file_py = "." + filebase + '.csv'
+csv_file_ns3 = "./scratch" + filebase + '.csv'
+
+
+# Function to get the mean KPIs over the seeds of one scenario and error model, once they have been simulated
+def get_means(args, nSta):
+    sums = dict((name, 0.0) for name in run_wifi_seq.kpi_names)
+    n = 0
+    for seed in range(args["seed"], args["lastSeed"] + 1):
+        seed_file = wifi_cache.get_seed_file(ns3_script, args, seed)
+        if seed_file is None:
+            print "Seed", seed, "failed!"
+            continue
+        kpis = run_wifi_seq.read_kpis(seed_file, nSta)
+        for name in kpis:
+            sums[name] += kpis[name]
+        n += 1
+    return dict((name, sums[name] / n if n else 0.0) for name in sums)
+
+
+def main():
+    print "Creating file ", csv_file_py
+    print "Simulating", len(scenarios), "scenario(s) with", num_seeds, "seed(s) for each error model"
+    print
+    arg_list = []
+    for nSta in scenarios:
+        for error_model in ["nist", "table"]:
+            args = {}
+            args["simulationTime"] = 15
+            args["seed"] = 1
+            args["lastSeed"] = num_seeds
+            args["csvFileName"] = csv_file_ns3
+            args["band"] = "AX_5"
+            args["phyModel"] = "spectrum"
+            args["constantMcs"] = 1
+            args["nStaA"] = nSta[0]
+            args["nStaB"] = nSta[1]
+            args["nStaC"] = nSta[2]
+            args["errorModel"] = error_model
+            arg_list.append(args)
+    wifi_cache.simulate_pool(ns3_script, arg_list, csv_file_py, num_workers)
+
+    rows = []
+    for k in range(len(scenarios)):
+        nSta = scenarios[k]
+        mix = "-".join(str(n) for n in nSta)
+        nist = get_means(arg_list[2 * k], nSta)
+        table = get_means(arg_list[2 * k + 1], nSta)
+        print
+        print "Scenario", mix
+        for name in run_wifi_seq.kpi_names:
+            deviation = (table[name] - nist[name]) / nist[name] if nist[name] != 0 else 0.0
+            print "%-9s nist %.6g table %.6g deviation %+.3f%%" % (name, nist[name], table[name], 100 * deviation)
+            rows.append([mix, name, nist[name], table[name], deviation])
+        print
+
+    with open(csv_file_py[:-4] + "_validation.csv", 'w') as file:
+        writer = csv.writer(file)
+        writer.writerow(["scenario", "kpi", "nist", "table", "deviation"])
+        for row in rows:
+            writer.writerow(row)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Sequential stopping: seeds are added in rounds until the confidence interval of every
+# per-slice KPI (Pe and latency of A/B/C, txPower of B) is narrower than the requested
+# relative half-width, with at least min_seeds and at most max_seeds seeds.
+# Running mean and variance of each KPI are kept with Welford's algorithm.
+
+# Import
+from datetime import datetime
+import multiprocessing
+import wifi_cache
+import math
+import csv
+
+# Options
+min_seeds = 5               # seeds always simulated
+max_seeds = 50              # seeds simulated at most
+seeds_per_round = 3         # seeds added at each round after the first one (min_seeds)
+num_jobs = multiprocessing.cpu_count() # seeds of a round simulated in parallel
+rel_half_width = 0.05       # requested CI half-width, relative to the mean
+notes = "6-100-2"           # notes to be written in the .csv file
+ns3_script = "wifi_dynamic" # ns3 script to be launched
+
+timestamp = datetime.now().strftime('%Y-%m-%d_%H:%M:%S')
+filebase = "/testfile_" + timestamp
+csv_file_py = "." + filebase + '.csv'
+csv_file_ns3 = "./scratch" + filebase + '.csv'
+
+# Two-sided 95% quantiles of the Student t distribution, for 1 to 30 degrees of freedom
+t_table = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+           2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+           2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+kpi_names = ["peA", "latencyA", "peB", "latencyB", "peC", "latencyC", "txPowerB"]
+
+
+class Welford:
+    def __init__(self):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+
+    def add(self, value):
+        self.n += 1
+        delta = value - self.mean
+        self.mean += delta / self.n
+        self.m2 += delta * (value - self.mean)
+
+    # half-width of the 95% confidence interval of the mean
+    def half_width(self):
+        if self.n < 2:
+            return float('inf')
+        t = t_table[self.n - 2] if self.n - 1 <= len(t_table) else 1.960
+        return t * math.sqrt(self.m2 / (self.n - 1) / self.n)
+
+    def converged(self):
+        half_width = self.half_width()
+        if self.mean == 0:
+            return half_width == 0
+        return half_width <= rel_half_width * abs(self.mean)
+
+
+# Function to read the KPIs of one seed from its .csv output
+def read_kpis(file_name, nSta):
+    with open(file_name) as file:
+        rows = [row for row in csv.reader(file) if row]
+    stations = rows[-sum(nSta):] # every script ends with the final station rows
+    configs = [row for row in rows if len(row) == 5 and row[0].strip().lstrip('-').isdigit()]
+    kpis = {}
+    first = 0
+    for s, name in zip(range(3), "ABC"):
+        pe = []
+        latency = []
+        for row in stations[first:first + nSta[s]]:
+            txPackets, rxPackets = float(row[3]), float(row[4])
+            if txPackets > 0:
+                pe.append((txPackets - rxPackets) / txPackets)
+            if rxPackets > 0:
+                latency.append(float(row[5]))
+        kpis["pe" + name] = sum(pe) / len(pe) if pe else 0.0
+        kpis["latency" + name] = sum(latency) / len(latency) if latency else 0.0
+        first += nSta[s]
+    if len(configs) >= 3:
+        kpis["txPowerB"] = float(configs[-2][4]) # last configuration: rows A, B, C
+    return kpis
+
+
+def main():
+    args = {}
+    args["simulationTime"] = 15
+    args["csvFileName"] = csv_file_ns3
+    args["band"] = "AX_5"
+    args["phyModel"] = "spectrum"
+    args["constantMcs"] = 1
+    args["nStaA"] = 6
+    args["nStaB"] = 100
+    args["nStaC"] = 2
+    nSta = [args["nStaA"], args["nStaB"], args["nStaC"]]
+
+    print "Creating file ", csv_file_py
+    print "Simulating from", min_seeds, "to", max_seeds, "seed(s) until a relative CI half-width of", rel_half_width
+    print
+    with open(csv_file_py, 'w') as file:
+        writer = csv.writer(file)
+        writer.writerow(["scenarios", 1])
+        writer.writerow(["seeds per scenario", "sequential"])
+        writer.writerow(["notes", ns3_script + ". " + notes])
+        writer.writerow(["arg_list[0]", args])
+        writer.writerow(["rel_half_width", rel_half_width])
+
+    stats = dict((name, Welford()) for name in kpi_names)
+    next_seed = 1
+    while next_seed <= max_seeds:
+        round_size = max(min_seeds if next_seed == 1 else seeds_per_round, 1)
+        last_seed = next_seed - 1 + min(round_size, max_seeds - (next_seed - 1))
+        args["seed"] = next_seed
+        args["lastSeed"] = last_seed
+        args["jobs"] = min(num_jobs, last_seed - next_seed + 1)
+        print "Calling the ns3 script '" + ns3_script + ".cc' for seeds", next_seed, "to", last_seed
+        wifi_cache.simulate(ns3_script, args, csv_file_py)
+        for seed in range(next_seed, last_seed + 1):
+            seed_file = wifi_cache.get_seed_file(ns3_script, args, seed)
+            if seed_file is None:
+                print "Seed", seed, "failed!"
+                continue
+            kpis = read_kpis(seed_file, nSta)
+            for name in kpis:
+                stats[name].add(kpis[name])
+        next_seed = last_seed + 1
+        print
+        for name in kpi_names:
+            if stats[name].n > 0:
+                print "%-9s mean %.6g +- %.3g (%d seeds)" % (name, stats[name].mean, stats[name].half_width(), stats[name].n)
+        print
+        if next_seed > min_seeds and all(stats[name].converged() for name in kpi_names if stats[name].n > 0):
+            break
+
+    with open(csv_file_py[:-4] + "_summary.csv", 'w') as file:
+        writer = csv.writer(file)
+        writer.writerow(["kpi", "seeds", "mean", "half_width", "converged"])
+        for name in kpi_names:
+            if stats[name].n > 0:
+                writer.writerow([name, stats[name].n, stats[name].mean, stats[name].half_width(), stats[name].converged()])
+
+
+if __name__ == "__main__":
+    main()
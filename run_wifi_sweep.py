@@ -0,0 +1,240 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Sweep of the slice parameters over a design of experiments
+# Every point of the design is simulated with num_seeds seeds and written to its own .csv shard, named after
+# the key of the point (hash of the ns3 script, of the fixed arguments, of num_seeds and of the values of the point,
+# also written in design.csv).
+# The controller of the ns3 script would overwrite the swept slice parameters: they are kept for the
+# whole run through pinConfig, and a sweep of arguments that the script overwrites anyway is refused.
+# The keys of the completed points are recorded in the checkpoint file, so that an interrupted sweep
+# launched again resumes where it stopped, while the points changed by new options are simulated again.
+# With screen, the points are not simulated: the analytical estimator of the ns3 script ranks
+# all of them in one run (seed design_seed) and the ranking is written to screen.csv. Only the arguments
+# which the script sets per candidate (screenable_args) can then be swept.
+
+# Import
+import subprocess
+import multiprocessing
+import itertools
+import random
+import csv
+import os
+import hashlib
+import json
+import wifi_cache
+
+# Options
+design = "factorial"        # "factorial", "lhs" or "random"
+num_points = 100            # number of points of the "lhs" and "random" designs
+design_seed = 1             # seed used to draw the "lhs" and "random" designs
+num_seeds = 20              # how many times each point is simulated
+num_workers = multiprocessing.cpu_count() # points simulated in parallel
+ns3_script = "wifi_dynamic" # ns3 script to be launched
+sweep_name = "sweep"        # name of the sweep (folder of the shards and of the checkpoint)
+screen = False              # rank the points with the analytical estimator instead of simulating them
+
+# Fixed arguments, passed to every point
+fixed_args = {}
+fixed_args["simulationTime"] = 15
+fixed_args["band"] = "AX_5"
+fixed_args["phyModel"] = "spectrum"
+fixed_args["constantMcs"] = 1
+fixed_args["pinConfig"] = 1 # the controller is not run, the slices keep the configuration of the point
+
+# Levels of the swept arguments
+ranges = {}
+ranges["channelWidthA"] = [20, 40, 80]
+ranges["mcsA"] = [3, 5, 7]
+#ranges["giA"] = [800, 1600, 3200]
+#ranges["txPowerA"] = [10, 15, 20]
+#ranges["channelWidthB"] = [20, 40]
+#ranges["mcsB"] = [1, 3, 5]
+#ranges["giB"] = [800, 1600, 3200]
+ranges["txPowerB"] = [3, 10, 20]
+#ranges["channelWidthC"] = [20, 40]
+#ranges["mcsC"] = [3, 5, 7]
+#ranges["giC"] = [800, 1600, 3200]
+#ranges["txPowerC"] = [10, 15, 20]
+#ranges["nStaA"] = [2, 4, 6]
+#ranges["nStaB"] = [50, 100]
+#ranges["nStaC"] = [2, 4, 6]
+#ranges["dataRateMaxA"] = [61, 81, 101]
+#ranges["dataRateMaxB"] = [31, 51]
+#ranges["dataRateMaxC"] = [21, 41]
+
+# Arguments overwritten during the run by each ns3 script, and scripts keeping them with pinConfig
+slice_args = [name + s for s in "ABC" for name in ["channelNumber", "channelWidth", "gi", "mcs", "txPower"]]
+overwritten_args = {"wifi": slice_args,
+                    "wifi_dynamic": slice_args,
+                    "wifi_static": ["channelNumberA", "channelWidthA", "channelNumberB", "channelWidthB",
+                                    "channelNumberC", "channelWidthC"]}
+pinning_scripts = ["wifi_dynamic"]
+
+# Arguments which each ns3 script can set per screened candidate (its overridableOptions)
+# The others (topology, traffic, ...) are used before the candidates are read, so they cannot be screened
+screenable_args = {"wifi_dynamic": slice_args + ["controller", "controllerArgs", "pinConfig", "asyncController",
+                                                 "decisionDelay", "verbose",
+                                                 "probErrMaxA", "probErrMaxB", "offMaxB", "probErrMaxC", "latencyMaxC",
+                                                 "slaMargin", "maxQuietTicks", "monitorMinPackets", "triggerHoldoff"]}
+
+sweep_dir_py = "./" + sweep_name
+sweep_dir_ns3 = "./scratch/" + sweep_name
+checkpoint_file = sweep_dir_py + "/checkpoint.txt"
+design_file = sweep_dir_py + "/design.csv"
+candidates_file = "/candidates.txt"
+screen_file = "/screen.csv"
+
+
+# Function to generate the points of the design
+def get_design():
+    names = sorted(ranges.keys())
+    points = []
+    if design == "factorial":
+        for levels in itertools.product(*[ranges[name] for name in names]):
+            points.append(dict(zip(names, levels)))
+    elif design == "lhs":
+        # Latin hypercube: each argument takes every stratum of its levels once, in random order
+        rng = random.Random(design_seed)
+        strata = {}
+        for name in names:
+            strata[name] = [(k + rng.random()) / num_points for k in range(num_points)]
+            rng.shuffle(strata[name])
+        for k in range(num_points):
+            points.append(dict((name, ranges[name][int(strata[name][k] * len(ranges[name]))]) for name in names))
+    elif design == "random":
+        rng = random.Random(design_seed)
+        for k in range(num_points):
+            points.append(dict((name, rng.choice(ranges[name])) for name in names))
+    else:
+        raise ValueError("Wrong design value!")
+    return points
+
+
+# Function to get the swept arguments which the ns3 script overwrites, so that the points would not differ
+def get_overwritten(names):
+    if fixed_args.get("pinConfig") and ns3_script in pinning_scripts:
+        return []
+    return sorted(name for name in names if name in overwritten_args.get(ns3_script, []))
+
+
+# Function to get the swept arguments which the screen of the ns3 script cannot set per candidate
+def get_unscreenable(names):
+    return sorted(name for name in names if name not in screenable_args.get(ns3_script, []))
+
+
+# Function to get the key of a point, which changes with any option that changes its results
+def get_point_key(values):
+    arg = dict(fixed_args)
+    arg.update(values)
+    arg["lastSeed"] = num_seeds
+    config = dict((str(name), str(arg[name])) for name in arg)
+    return hashlib.sha1((ns3_script + json.dumps(config, sort_keys=True)).encode()).hexdigest()[:16]
+
+
+# Function to read the keys of the points already simulated
+def read_checkpoint():
+    if not os.path.exists(checkpoint_file):
+        return set()
+    with open(checkpoint_file) as file:
+        return set(line.strip() for line in file if line.strip())
+
+
+def main():
+    overwritten = get_overwritten(ranges.keys())
+    if overwritten:
+        print "'" + ns3_script + ".cc' overwrites", ", ".join(overwritten) + ": they cannot be swept!"
+        return
+    unscreenable = get_unscreenable(ranges.keys()) if screen else []
+    if unscreenable:
+        print "The candidates of '" + ns3_script + ".cc' cannot set", ", ".join(unscreenable) + ": they cannot be screened!"
+        return
+    if not os.path.exists(sweep_dir_py):
+        os.makedirs(sweep_dir_py)
+    points = get_design()
+    keys = [get_point_key(values) for values in points]
+    done = read_checkpoint()
+    with open(design_file, 'w') as file:
+        writer = csv.writer(file)
+        names = sorted(ranges.keys())
+        writer.writerow(["point", "key"] + names)
+        for k in range(len(points)):
+            writer.writerow([k, keys[k]] + [points[k][name] for name in names])
+    if screen:
+        screen_points(points)
+        return
+    todo = []
+    seen = set(done)
+    for k in range(len(points)):
+        if keys[k] not in seen: # a point drawn twice is simulated once
+            seen.add(keys[k])
+            todo.append((k, keys[k], points[k]))
+    print "Sweep", sweep_name + ":", design, "design with", len(points), "point(s),", len(points) - len(todo), "already simulated"
+    print "Simulating", len(todo), "point(s) with", num_seeds, "seed(s) each on", num_workers, "worker(s)"
+    print
+    if subprocess.call('(cd ..; ./waf build)', shell=True) != 0:
+        print "Build failed!"
+        return
+    pool = multiprocessing.Pool(num_workers)
+    with open(checkpoint_file, 'a') as file:
+        for k, key, status in pool.imap_unordered(simulate, todo):
+            if status == 0:
+                file.write(key + "\n")
+                file.flush()
+            else:
+                print "Point", k, "failed!"
+    pool.close()
+    pool.join()
+
+
+# Function to rank the points with the analytical estimator, without simulating them
+# Line k+1 of the candidates file is point k
+def screen_points(points):
+    with open(sweep_dir_py + candidates_file, 'w') as file:
+        for values in points:
+            file.write(" ".join(name + "=" + str(values[name]) for name in sorted(values)) + "\n")
+    arg = dict(fixed_args)
+    arg["phyModel"] = "abstract" # the devices are not needed
+    arg["seed"] = design_seed
+    arg["screenFileName"] = sweep_dir_ns3 + candidates_file
+    arg["csvFileName"] = sweep_dir_ns3 + screen_file
+    if os.path.exists(sweep_dir_py + screen_file):
+        os.remove(sweep_dir_py + screen_file)
+    print "Screening", len(points), "point(s) with the estimator of '" + ns3_script + ".cc'"
+    if subprocess.call('(cd ..; ./waf --run "' + ns3_script + wifi_cache.get_arguments(arg) + '")', shell=True) != 0:
+        print "Screening failed!"
+        return
+    with open(sweep_dir_py + screen_file) as file:
+        rows = [row for row in csv.reader(file) if row]
+    print "Best points (rank, point, slices meeting their SLA, spectrum [MHz], txPowerB [dBm]):"
+    for row in rows[1:11]:
+        print row[0], int(row[1]) - 1, row[2], row[3], row[4]
+
+
+def simulate(point):
+    k, key, values = point
+    overwritten = get_overwritten(values.keys())
+    if overwritten:
+        print "Point", k, "not simulated: '" + ns3_script + ".cc' overwrites", ", ".join(overwritten)
+        return k, key, 1
+    shard_ns3 = sweep_dir_ns3 + "/point_" + key + ".csv"
+    shard_py = sweep_dir_py + "/point_" + key + ".csv"
+    for partial in [shard_py, shard_py[:-4] + "_journal.csv"]:
+        if os.path.exists(partial):
+            os.remove(partial) # output of an interrupted run
+    arg = dict(fixed_args)
+    arg.update(values)
+    arg["seed"] = 1
+    arg["lastSeed"] = num_seeds
+    arg["csvFileName"] = shard_ns3
+    print "Calling the ns3 script '" + ns3_script + ".cc' for point", k
+    with open(os.devnull, 'w') as devnull:
+        status = wifi_cache.simulate(ns3_script, arg, shard_py, "--run-no-build", devnull)
+    return k, key, status
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * Seed pool shared by the ns-3 scripts: the seeds of a batch run in child processes forked after the
+ * command line has been parsed, so that waf and the ns-3 libraries are loaded only once.
+ * Every child starts from the same state as a separate launch (ns-3 keeps static RNG stream, node
+ * and channel counters that cannot be reset in-process), so the results are identical to one run per seed.
+ *
+ * Each output file of the script is described by a SeedOutput: with jobs > 1 or keepShards each child writes
+ * its own shard of it (<file>.seed<k>) and, unless keepShards, the shards are merged in seed order, without the
+ * header of all but the first one, once every seed has finished.
+ *
+ */
+
+#ifndef SEED_POOL_H
+#define SEED_POOL_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Output file of a script, written by every seed
+struct SeedOutput
+{
+  std::string* fileName;  // option holding the file name (empty = file not written)
+  std::size_t headerSize; // bytes of the header of each shard
+};
+
+
+// function to merge the shard written by seed s into fileName, without the header of the shard
+// when fileName already has one
+inline void merge_shard (std::string fileName, int s, std::size_t headerSize)
+{
+  std::string shardName = fileName + ".seed" + std::to_string (s);
+  std::ifstream shard (shardName.c_str (), std::ios::binary);
+  if (!shard.good ())
+    return;
+  bool newFile = !std::ifstream (fileName.c_str ()).good ();
+  std::ofstream out (fileName.c_str (), std::ios::app | std::ios::binary);
+  if (!newFile)
+    shard.seekg (headerSize);
+  if (shard.peek () != EOF)
+    out << shard.rdbuf ();
+  shard.close ();
+  out.close ();
+  std::remove (shardName.c_str ());
+}
+
+
+// function to wait for the end of one of the processes forked by the script (seeds or variants)
+// Returns 1 if it failed, 0 otherwise
+inline int wait_seed()
+{
+  int status;
+  pid_t pid = wait (&status);
+  if (pid > 0 && (!WIFEXITED (status) || WEXITSTATUS (status) != 0))
+  {
+    std::cout << "\033[91m" << "Process " << pid << " of the batch failed!" << "\033[0m" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+
+// function to run the seeds seed, ..., lastSeed in child processes, up to jobs at the same time.
+// In the child seed is set to its own seed and the file names of outputs to its shards.
+// Returns -1 in the child, which runs the simulation for its seed, and the number of failed seeds in the parent
+inline int fork_seeds (int& seed, int lastSeed, int jobs, bool keepShards, const std::vector<SeedOutput>& outputs)
+{
+  jobs = std::max (jobs, 1);
+  lastSeed = std::max (lastSeed, seed);
+  int running = 0, failed = 0;
+  for (int s = seed; s <= lastSeed; s++)
+  {
+    if (running == jobs)
+    {
+      failed += wait_seed();
+      running--;
+    }
+    std::cout << "\033[94m" << "Running seed " << s << " of " << lastSeed << "\033[0m" << std::endl;
+    pid_t pid = fork ();
+    if (pid < 0)
+    {
+      std::cout << "\033[91m" << "Cannot fork seed " << s << "!" << "\033[0m" << std::endl;
+      failed += lastSeed - s + 1;
+      break;
+    }
+    if (pid == 0)
+    {
+      if (jobs > 1 || keepShards)
+      {
+        for (std::size_t k = 0; k < outputs.size (); k++)
+        {
+          if (*outputs[k].fileName != "")
+            *outputs[k].fileName += ".seed" + std::to_string (s);
+        }
+      }
+      seed = s;
+      return -1;
+    }
+    running++;
+  }
+  for (; running > 0; running--)
+    failed += wait_seed();
+  if (jobs > 1 && !keepShards)
+  {
+    for (int s = seed; s <= lastSeed; s++)
+    {
+      for (std::size_t k = 0; k < outputs.size (); k++)
+      {
+        if (*outputs[k].fileName != "")
+          merge_shard (*outputs[k].fileName, s, outputs[k].headerSize);
+      }
+    }
+  }
+  return failed;
+}
+
+#endif /* SEED_POOL_H */
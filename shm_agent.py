@@ -0,0 +1,138 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Stand-in agent for the shared memory controller (shm_controller.cpp, layout described in its header)
+# It maps the segment created by the ns3 script, reads every observation in place and answers with an
+# action of the same tick. The policy only adapts the tx power of slice B to the Pe of its STAs, as
+# power_controller.cpp does: a learning agent would replace the function policy.
+# Launch it before or after the ns3 script, e.g.
+#   python shm_agent.py &
+#   python run_wifi.py   (with args["controller"] = "./libshm_controller.so")
+
+# Import
+import struct
+import mmap
+import time
+import os
+
+# Options
+shm_name = "wifi_slicing"   # name of the shared memory segment (controllerArgs name=...)
+idle_timeout = 10           # seconds without observations, after the first one, after which the agent stops (0 = never)
+prob_err_max = 0.02         # max Pe of a STA B
+off_max = 0.1               # max fraction of STAs B above prob_err_max
+step = 1                    # dB
+tx_power_min = 0            # dBm
+tx_power_max = 20           # dBm
+
+header_format = "=4sIIIIIQ"
+counter_offsets = {"obsHead": 64, "obsTail": 128, "actHead": 192, "actTail": 256}
+header_size = 320
+obs_format = "=iid3i3i15ii"
+act_format = "=ii15i"
+layout_version = 2
+keep = -2 ** 31            # action field keeping the current value (INT32_MIN: a tx power may be negative)
+
+
+class Segment:
+    def __init__(self, path):
+        file = open(path, "r+b")
+        self.map = mmap.mmap(file.fileno(), 0)
+        file.close()
+        magic, version, self.n_sta, self.slots, self.obs_size, self.act_size, self.session = \
+            struct.unpack_from(header_format, self.map, 0)
+        self.valid = magic == "WSHM" and version == layout_version and self.map.size() >= header_size + self.slots * (self.obs_size + self.act_size)
+        self.obs_ring = header_size
+        self.act_ring = header_size + self.slots * self.obs_size
+
+    def get(self, name):
+        return struct.unpack_from("=Q", self.map, counter_offsets[name])[0]
+
+    def set(self, name, value):
+        struct.pack_into("=Q", self.map, counter_offsets[name], value)
+
+    def current(self):
+        magic, session = struct.unpack_from("=4s", self.map, 0)[0], struct.unpack_from("=Q", self.map, 24)[0]
+        return magic == "WSHM" and session == self.session
+
+    # Function to read observation k in place
+    def observation(self, k):
+        offset = self.obs_ring + (k % self.slots) * self.obs_size
+        fields = struct.unpack_from(obs_format, self.map, offset)
+        n = self.n_sta
+        obs = {"tick": fields[0], "kind": fields[1], "time": fields[2],
+               "nSta": list(fields[3:6]), "dataRateSum": list(fields[6:9]),
+               "config": [list(fields[9 + 5 * s:14 + 5 * s]) for s in range(3)]}
+        offset += struct.calcsize(obs_format)
+        for name, fmt, size in [("rxPower", "d", 8), ("latency", "d", 8), ("probErr", "d", 8),
+                                ("txPackets", "I", 4), ("rxPackets", "I", 4)]:
+            obs[name] = struct.unpack_from("=" + str(n) + fmt, self.map, offset)
+            offset += n * size
+        return obs
+
+    # Function to publish the action of a tick
+    def act(self, tick, config):
+        k = self.get("actHead")
+        values = [tick, 0] + [value for slice_config in config for value in slice_config]
+        struct.pack_into(act_format, self.map, self.act_ring + (k % self.slots) * self.act_size, *values)
+        self.set("actHead", k + 1) # written after the record
+
+
+# Function to compute the action of an observation: keep keeps the current value
+def policy(obs):
+    config = [[keep] * 5 for s in range(3)]
+    if obs["kind"] == 0:
+        return config # the initial configuration of the script is kept
+    n_sta_a, n_sta_b = obs["nSta"][0], obs["nSta"][1]
+    n_off = sum(1 for pe in obs["probErr"][n_sta_a:n_sta_a + n_sta_b] if pe > prob_err_max)
+    tx_power = obs["config"][1][4]
+    if n_off > off_max * n_sta_b:
+        tx_power += step
+    elif n_off == 0:
+        tx_power -= step
+    config[1][4] = max(tx_power_min, min(tx_power_max, tx_power))
+    return config
+
+
+def main():
+    path = "/dev/shm/" + shm_name.lstrip("/")
+    print "Waiting for", path
+    segment = None
+    steps = 0
+    start = None
+    last = time.time()
+    while True:
+        if segment is None or not segment.current():
+            if segment is not None and steps > 0:
+                print "Run ended:", steps, "step(s),", int(steps / max(time.time() - start, 1e-9)), "steps/s"
+            segment = None
+            if os.path.exists(path) and os.path.getsize(path) >= header_size:
+                candidate = Segment(path)
+                if candidate.valid:
+                    segment = candidate
+                    steps = 0
+                    print "Attached to", path + ":", segment.n_sta, "STAs,", segment.slots, "slots"
+            if segment is None:
+                time.sleep(0.01)
+                continue
+        tail = segment.get("obsTail")
+        if tail < segment.get("obsHead"):
+            obs = segment.observation(tail)
+            segment.set("obsTail", tail + 1)
+            segment.act(obs["tick"], policy(obs))
+            if steps == 0:
+                start = time.time()
+            steps += 1
+            last = time.time()
+        elif idle_timeout > 0 and start is not None and time.time() - last > idle_timeout:
+            break
+        else:
+            time.sleep(0.00005)
+    if steps > 0:
+        print "Stopped after", steps, "step(s),", int(steps / max(last - start, 1e-9)), "steps/s"
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,320 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * Slice controller bridging the ns-3 scripts to an external agent (e.g. a learning algorithm written in Python)
+ * through POSIX shared memory. At each control tick the KPI snapshot is written straight into a slot of the
+ * observation ring, and the controller waits for the action of the same tick in the action ring, up to a
+ * timeout. The action goes back to the script, which applies it as the output of any other controller.
+ * No socket and no serialization are involved: the agent maps the same segment and reads the records in place.
+ * shm_agent.py is a stand-in agent.
+ *
+ * Build it with
+ *
+ *   g++ -std=c++11 -O2 -shared -fPIC -I scratch -o libshm_controller.so scratch/shm_controller.cpp -lrt
+ *
+ * and select it with
+ *
+ *   ./waf --run "wifi_dynamic --controller=./libshm_controller.so --controllerArgs=name=/wifi_slicing,timeout=1000"
+ *
+ * Arguments (name=value, separated by spaces or commas):
+ *   name     name of the shared memory segment (/dev/shm/<name> on Linux)
+ *   slots    records of each ring
+ *   timeout  max wait for an action [ms] (negative = no limit); on timeout the configuration is not changed
+ *   agent    label of the agent, not used by the controller: the results depend on the agent, which
+ *            wifi_cache.py only sees through the arguments
+ *
+ * Layout of the segment, native byte order, every offset a multiple of 64:
+ *
+ *   header      (320 bytes)  char magic[4] "WSHM", uint32 version, uint32 nSta, uint32 slots,
+ *                            uint32 obsSize, uint32 actSize, uint64 session, then at offsets 64, 128, 192, 256
+ *                            the uint64 counters obsHead, obsTail, actHead, actTail
+ *   observation ring         slots records of obsSize bytes, record k at slot k % slots
+ *   action ring              slots records of actSize bytes
+ *   (obsSize and actSize are the sizes of the records below rounded up to a multiple of 64)
+ *
+ *   observation record       int32 tick, int32 kind (0 initialize, 1 update), double time,
+ *                            int32 nSta[3], int32 dataRateSum[3], int32 config[3][5], int32 padding,
+ *                            then nSta values each of double rxPower [dBm], double latency [ms], double probErr,
+ *                            uint32 txPackets, uint32 rxPackets (the last two on the last control window)
+ *   action record            int32 tick, int32 padding, int32 config[3][5]
+ *
+ * config[s] holds channelNumber, channelWidth, gi, mcs and txPower of slice s; the value INT32_MIN (-2^31)
+ * in an action keeps the current value (a tx power may be negative). obsHead and actHead count the records published by the simulator and by the agent,
+ * obsTail and actTail those consumed by the agent and by the simulator. A record is written before its head
+ * is increased. The session changes at each run, so that the agent can tell a new run from the previous one.
+ * The segment serves one run at a time: give each seed of a batch its own name. When the run ends, the magic is
+ * cleared, so that an agent still mapping the segment can tell that the run is over, and the segment is unlinked.
+ *
+ */
+
+#include "slice_controller.h"
+#include <atomic>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+struct ShmHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t nSta;
+  uint32_t slots;
+  uint32_t obsSize;
+  uint32_t actSize;
+  uint64_t session;
+  char pad0[32];
+  std::atomic<uint64_t> obsHead; // observations published by the simulator
+  char pad1[56];
+  std::atomic<uint64_t> obsTail; // observations consumed by the agent
+  char pad2[56];
+  std::atomic<uint64_t> actHead; // actions published by the agent
+  char pad3[56];
+  std::atomic<uint64_t> actTail; // actions consumed by the simulator
+  char pad4[56];
+};
+
+struct ObsRecord
+{
+  int32_t tick;
+  int32_t kind;
+  double time;
+  int32_t nSta[3];
+  int32_t dataRateSum[3];
+  int32_t config[3][5];
+  int32_t pad;
+  // followed by the station columns
+};
+
+struct ActRecord
+{
+  int32_t tick;
+  int32_t pad;
+  int32_t config[3][5];
+};
+
+const int32_t keepValue = INT32_MIN; // field of an action keeping the current value
+const uint32_t layoutVersion = 2;    // 2: keepValue instead of any negative value
+
+static_assert (sizeof (ShmHeader) == 320, "unexpected layout of the shared memory header");
+static_assert (sizeof (ObsRecord) == 104, "unexpected layout of the observation record");
+static_assert (sizeof (ActRecord) == 68, "unexpected layout of the action record");
+
+
+class ShmController : public SliceController
+{
+public:
+  ShmController (const char* args);
+  virtual ~ShmController ();
+  virtual void Initialize (const KpiSnapshot& kpi, SliceConfig config[3]);
+  virtual void Update (const KpiSnapshot& kpi, SliceConfig config[3]);
+
+private:
+  bool Open (int nSta);
+  void Step (const KpiSnapshot& kpi, SliceConfig config[3], int kind);
+
+  std::string name = "/wifi_slicing";
+  uint32_t slots = 16;
+  int timeout = 1000; // ms
+  ShmHeader* header = 0;
+  std::size_t size = 0;   // bytes of the mapping
+  char* obsRing = 0;
+  char* actRing = 0;
+};
+
+
+// function to parse the arguments of the controller (name=value ..., separated by spaces or commas)
+ShmController::ShmController (const char* args)
+{
+  std::string list (args);
+  for (std::size_t i = 0; i < list.size (); i++)
+  {
+    if (list[i] == ',') list[i] = ' ';
+  }
+  std::istringstream tokens (list);
+  std::string token;
+  while (tokens >> token)
+  {
+    std::size_t equal = token.find ('=');
+    std::string option = token.substr (0, equal);
+    std::istringstream value (equal == std::string::npos ? "" : token.substr (equal + 1));
+    if (option == "name") value >> name;
+    else if (option == "slots") value >> slots;
+    else if (option == "timeout") value >> timeout;
+    else if (option == "agent") continue;
+    else std::cout << "Unknown argument of the shm controller: " << token << std::endl;
+  }
+  if (name.empty () || name[0] != '/')
+    name = "/" + name;
+  if (slots == 0)
+    slots = 1;
+}
+
+
+// function to release the shared memory segment: the agent sees the cleared magic, then the segment is unlinked
+ShmController::~ShmController ()
+{
+  if (!header)
+    return;
+  std::atomic_thread_fence (std::memory_order_release);
+  std::memset (header->magic, 0, 4);
+  munmap (header, size);
+  shm_unlink (name.c_str ());
+}
+
+
+// function to create the shared memory segment for nSta stations
+// Returns 0 if it cannot be created
+bool ShmController::Open (int nSta)
+{
+  uint32_t obsSize = (sizeof (ObsRecord) + nSta * (3 * sizeof (double) + 2 * sizeof (uint32_t)) + 63) / 64 * 64;
+  uint32_t actSize = (sizeof (ActRecord) + 63) / 64 * 64;
+  std::size_t bytes = sizeof (ShmHeader) + (std::size_t) slots * (obsSize + actSize);
+  int fd = shm_open (name.c_str (), O_CREAT | O_RDWR, 0600);
+  if (fd < 0)
+  {
+    *log << "Cannot create the shared memory " << name << ": " << std::strerror (errno) << std::endl;
+    return 0;
+  }
+  if (ftruncate (fd, bytes) != 0)
+  {
+    *log << "Cannot size the shared memory " << name << ": " << std::strerror (errno) << std::endl;
+    close (fd);
+    shm_unlink (name.c_str ());
+    return 0;
+  }
+  void* base = mmap (0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+  {
+    *log << "Cannot map the shared memory " << name << ": " << std::strerror (errno) << std::endl;
+    shm_unlink (name.c_str ());
+    return 0;
+  }
+  std::memset (base, 0, bytes);
+  header = new (base) ShmHeader;
+  size = bytes;
+  header->version = layoutVersion;
+  header->nSta = nSta;
+  header->slots = slots;
+  header->obsSize = obsSize;
+  header->actSize = actSize;
+  header->session = (uint64_t) getpid () << 32 ^ (uint64_t) time (0);
+  header->obsHead.store (0);
+  header->obsTail.store (0);
+  header->actHead.store (0);
+  header->actTail.store (0);
+  obsRing = (char*) base + sizeof (ShmHeader);
+  actRing = obsRing + (std::size_t) slots * obsSize;
+  std::atomic_thread_fence (std::memory_order_release);
+  std::memcpy (header->magic, "WSHM", 4); // written last: the agent waits for it
+  *log << "Shared memory " << name << ": " << nSta << " STAs, " << slots << " slots" << std::endl;
+  return 1;
+}
+
+
+// function to publish the snapshot and apply the action of the agent for the same tick
+void ShmController::Step (const KpiSnapshot& kpi, SliceConfig config[3], int kind)
+{
+  int nSta = kpi.nSta[0] + kpi.nSta[1] + kpi.nSta[2];
+  if (!header && !Open (nSta))
+    return;
+
+  // Observation, written in place unless the agent has not consumed the ring
+  uint64_t head = header->obsHead.load (std::memory_order_relaxed);
+  if (head - header->obsTail.load (std::memory_order_acquire) >= slots)
+  {
+    *log << "Shared memory " << name << ": observation ring full, tick " << kpi.tick << " not published" << std::endl;
+    return;
+  }
+  ObsRecord* obs = (ObsRecord*) (obsRing + (head % slots) * header->obsSize);
+  obs->tick = kpi.tick;
+  obs->kind = kind;
+  obs->time = kpi.time;
+  for (int s = 0; s < 3; s++)
+  {
+    obs->nSta[s] = kpi.nSta[s];
+    obs->dataRateSum[s] = kpi.dataRateSum[s];
+    int32_t values[5] = {config[s].channelNumber, config[s].channelWidth, config[s].gi, config[s].mcs, config[s].txPower};
+    std::memcpy (obs->config[s], values, sizeof (values));
+  }
+  double* rxPower = (double*) (obs + 1);
+  double* latency = rxPower + nSta;
+  double* probErr = latency + nSta;
+  uint32_t* txPackets = (uint32_t*) (probErr + nSta);
+  uint32_t* rxPackets = txPackets + nSta;
+  std::memcpy (rxPower, kpi.rxPower, nSta * sizeof (double));
+  std::memcpy (latency, kpi.latency[0], nSta * sizeof (double));
+  std::memcpy (probErr, kpi.probErr[0], nSta * sizeof (double));
+  for (int i = 0; i < nSta; i++)
+  {
+    txPackets[i] = kpi.txPackets[0][i] - (kpi.historyLength > 1 ? kpi.txPackets[1][i] : 0);
+    rxPackets[i] = kpi.rxPackets[0][i] - (kpi.historyLength > 1 ? kpi.rxPackets[1][i] : 0);
+  }
+  header->obsHead.store (head + 1, std::memory_order_release);
+
+  // Action of the same tick, older ones are discarded
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout);
+  for (int spin = 0; ; spin++)
+  {
+    uint64_t tail = header->actTail.load (std::memory_order_relaxed);
+    while (tail < header->actHead.load (std::memory_order_acquire))
+    {
+      ActRecord action = *(ActRecord*) (actRing + (tail % slots) * header->actSize);
+      header->actTail.store (++tail, std::memory_order_release);
+      if (action.tick != kpi.tick)
+        continue;
+      for (int s = 0; s < 3; s++)
+      {
+        int* fields[5] = {&config[s].channelNumber, &config[s].channelWidth, &config[s].gi, &config[s].mcs, &config[s].txPower};
+        for (int j = 0; j < 5; j++)
+        {
+          if (action.config[s][j] != keepValue) *fields[j] = action.config[s][j];
+        }
+      }
+      return;
+    }
+    if (timeout >= 0 && std::chrono::steady_clock::now () > deadline)
+    {
+      *log << "Shared memory " << name << ": no action for tick " << kpi.tick << " within " << timeout << " ms" << std::endl;
+      return;
+    }
+    // Spin first, since a local agent answers within microseconds, then sleep
+    if (spin < 1000)
+      std::this_thread::yield ();
+    else
+      std::this_thread::sleep_for (std::chrono::microseconds (50));
+  }
+}
+
+
+void ShmController::Initialize (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  Step (kpi, config, 0);
+}
+
+
+void ShmController::Update (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  Step (kpi, config, 1);
+}
+
+
+extern "C" SliceController* CreateSliceController (const char* args)
+{
+  return new ShmController (args);
+}
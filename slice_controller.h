@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * Slice controller interface, shared by the ns-3 scripts and by the controllers built as shared libraries.
+ *
+ * The script fills a read-only KPI snapshot and hands it to the controller with the configuration
+ * currently applied to each slice; the controller overwrites the configurations it wants to change
+ * and the script applies them.
+ *
+ * A controller library defines
+ *
+ *   extern "C" SliceController* CreateSliceController (const char* args);
+ *
+ * which is called once per run with the value of --controllerArgs, and is selected with
+ * --controller=<path of the library>. The header does not depend on ns-3, so that a controller
+ * can be built on its own, e.g.
+ *
+ *   g++ -std=c++11 -O2 -shared -fPIC -I scratch -o libmy_controller.so scratch/my_controller.cpp
+ *
+ */
+
+#ifndef SLICE_CONTROLLER_H
+#define SLICE_CONTROLLER_H
+
+#include <stdint.h>
+#include <iostream>
+
+// Configuration of a slice: channel number, channel width, guard interval, mcs and tx power
+struct SliceConfig
+{
+  int channelNumber;
+  int channelWidth; // 20, 40, 80 or 160 MHz
+  int gi;           // 800, 1600 or 3200 ns
+  int mcs;          // from 0 to 11
+  int txPower;      // dBm
+};
+
+// KPI snapshot: per-station arrays hold the STAs A first, then B, then C, and stay valid only during the call.
+// The windowed arrays are indexed [k][i], k being the age of the control window (0 = the last one)
+struct KpiSnapshot
+{
+  double time;                      // simulation time [s]
+  int tick;                         // control window (0 before the traffic starts)
+  int nSta[3];                      // # of STAs of slices A, B and C
+  int dataRateSum[3];               // offered load of slices A, B and C (Mb/s for A and C, Kb/s for B)
+  const int* dataRate;              // offered load of each STA (Mb/s for A and C, Kb/s for B)
+  const double* x;                  // initial position of each STA [m]
+  const double* y;
+  const double* loss;               // path loss from each STA to the AP [dB]
+  const double* rxPower;            // rx power at the AP with the applied tx power [dBm]
+  int historyLength;                // # of control windows of the windowed arrays
+  const uint32_t* const* txPackets; // # txPackets until the end of each window
+  const uint32_t* const* rxPackets; // # rxPackets until the end of each window
+  const double* const* latency;     // average latency until the end of each window [ms]
+  const double* const* probErr;     // Pe on each window
+  SliceConfig applied[3];           // configuration applied to slices A, B and C
+};
+
+// Slice controller: computes the configuration of slices A, B and C
+class SliceController
+{
+public:
+  virtual ~SliceController () {}
+
+  // function called once before the traffic starts (tick 0, no packet counted yet)
+  virtual void Initialize (const KpiSnapshot& kpi, SliceConfig config[3]) = 0;
+
+  // function called at the end of each control window
+  virtual void Update (const KpiSnapshot& kpi, SliceConfig config[3]) = 0;
+
+  // stream Initialize and Update print to, instead of std::cout: the script sets it to a buffer
+  // while Update runs on a worker thread, and prints the buffer itself
+  std::ostream* log = &std::cout;
+};
+
+typedef SliceController* (*CreateSliceControllerFunction) (const char* args);
+
+#endif /* SLICE_CONTROLLER_H */
@@ -55,6 +55,9 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/multi-model-spectrum-channel.h"
 #include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/constant-rate-wifi-manager.h"
+#include "ns3/he-configuration.h"
 #include "ns3/qos-txop.h"
 #include "ns3/wifi-mac.h"
 #include "ns3/rng-seed-manager.h"
@@ -62,8 +65,18 @@
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/netanim-module.h"
 #include "ns3/buildings-module.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/nist-error-rate-model.h"
 #include "ns3/ipv4-flow-classifier.h"
+#include "ns3/tag.h"
 #include <bits/stdc++.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include "slice_controller.h"
+#include "seed_pool.h"
+#include "wifi_models.h"
+#include "wifi_common.h"
 
 #define ENDC    "\033[0m"
 #define ERROR   "\033[91m"
@@ -79,18 +92,41 @@ NS_LOG_COMPONENT_DEFINE ("wifi_dynamic");
 // Options
 uint32_t payloadSize = 1472;          // bytes (UDP)
 double simulationTime = 15;           // seconds
+double controlInterval = 1;           // control period T: update_channels is called every T seconds of traffic
+bool verbose = 1;                     // 1 prints the Pe of every STA at each control tick
 int seed = 1;                         // seed used in the simulation
+int lastSeed = 0;                     // last seed of a batch (0 = only seed)
+int jobs = 1;                         // seeds of a batch run at the same time
+bool keepShards = 0;                  // 1 leaves the shard of each seed unmerged
+std::string variantFile = "";         // variants run from the start of the traffic (empty = none)
+std::string controllerLibrary = "";   // shared library of the slice controller (empty = built-in controller)
+std::string controllerArgs = "";      // arguments passed to the controller of the library
+bool asyncController = 0;             // 1 runs the controller on a worker thread while the simulation goes on
+double decisionDelay = -1;            // delay between the KPI sample and the decision of the worker [s] (negative = compute time)
+double asyncPollStep = 0.001;         // simulation step between two checks of the worker [s]
 std::string csvFileName = "test.csv"; // csv file name
+std::string binFileName = "";         // binary file name (empty = no binary output)
+uint32_t runId = 0;                   // run identifier written in the binary file (0 = seed)
 std::string band = "AX_5";            // AC_5, AX_2.4 or AX_5
 std::string phyModel = "spectrum";    // "spectrum" or "yans"
 bool constantMcs = 1;                 // 0 Minstrel or 1 constant
 bool enablePcap = 0;                  // 0 no Pcap or 1 Pcap
+bool channelPerSlice = 0;             // 1 one spectrum channel per slice (slice bands must not overlap)
+double gridStep = 0;                  // step of the AP path loss grid [m] (0 = exact model)
+std::string gridFileName = "";        // file the AP path loss grid is loaded from or saved to (empty = none)
+std::string errorModel = "nist";      // "nist" or "table" (Nist model served from tables)
 double x_max = 20.0;                  // meters
 double y_max = 10.0;                  // meters
 double z_max = 3.0;                   // meters
-const int nStaA = 6;                  // number of stations A
-const int nStaB = 100;                // number of stations B
-const int nStaC = 2;                  // number of stations C
+int nStaA = 6;                        // number of stations A
+int nStaB = 100;                      // number of stations B
+int nStaC = 2;                        // number of stations C
+int dataRateMinA = 80;                // data rate A drawn in [min, max) Mb/s
+int dataRateMaxA = 101;
+int dataRateMinB = 30;                // data rate B drawn in [min, max) Kb/s
+int dataRateMaxB = 51;
+int dataRateMinC = 20;                // data rate C drawn in [min, max) Mb/s
+int dataRateMaxC = 41;
 
 
 // Additional options needed to initialize the channel object, do not change them!
@@ -118,38 +154,48 @@ std::string dataRateC_fixed = "10Mb/s";
 
 
 // Utility variables definition
-std::vector<int> dataRateA(nStaA);
-std::vector<int> dataRateB(nStaB);
-std::vector<int> dataRateC(nStaC);
+std::vector<int> dataRateA;
+std::vector<int> dataRateB;
+std::vector<int> dataRateC;
 
 int dataRateSumA = 0;
 int dataRateSumB = 0;
 int dataRateSumC = 0;
 
-std::vector<uint64_t> rxPacketsA_meas(nStaA);
-std::vector<uint64_t> rxPacketsB_meas(nStaB);
-std::vector<uint64_t> rxPacketsC_meas(nStaC);
+std::vector<uint64_t> rxPacketsA_meas;
+std::vector<uint64_t> rxPacketsB_meas;
+std::vector<uint64_t> rxPacketsC_meas;
 
-std::vector<double> pathLoss(nStaA+nStaB+nStaC);
-std::vector<double> rxPower(nStaA+nStaB+nStaC);
-
-std::vector<double> x(nStaA+nStaB+nStaC);
-std::vector<double> y(nStaA+nStaB+nStaC);
+std::vector<double> pathLoss;
 
 Ptr<FlowMonitor> flowMonitor;
 FlowMonitorHelper flowHelper;
+std::vector<int> flowStation; // station of each flow, indexed by FlowId (-1 = not classified yet)
+std::string kpiSource = "flowMonitor"; // KPIs from the "flowMonitor" or from the application traces ("trace")
+
+KpiCollector kpi;      // KPIs from the application traces (kpiSource = "trace")
+StationStore station;  // per-STA KPIs of the last control windows
+int historyLength = 2; // number of control windows kept in the station store (at least 2)
+
 
-std::vector<uint32_t> txPackets_unsort(nStaA+nStaB+nStaC);
-std::vector<uint32_t> rxPackets_unsort(nStaA+nStaB+nStaC);
-std::vector<double> latency_unsort(nStaA+nStaB+nStaC);
+// Slice registry: direct handles to the PHY, the rate manager and the HE configuration of every device of a slice
+struct SliceDevices
+{
+  std::vector<Ptr<WifiPhy> > phy;
+  std::vector<Ptr<ConstantRateWifiManager> > manager; // null if the device does not use ConstantRateWifiManager
+  std::vector<Ptr<HeConfiguration> > heConfiguration; // null if the device is not HE
+};
+
+SliceDevices sliceDevices[3]; // slices A, B and C
 
-uint32_t txPackets[2][nStaA+nStaB+nStaC]; // txPackets until t0 and t0-T
-uint32_t rxPackets[2][nStaA+nStaB+nStaC]; // rxPackets until t0 and t0-T
-double latency[2][nStaA+nStaB+nStaC];     // average latency until t0 and t0-T
+SliceConfig appliedConfig[3];    // configuration currently applied to the devices of slices A, B and C
+std::ostringstream journal;      // changes applied to the slices: seed, time, slice, parameter, old value, new value
+std::string journalFileName = ""; // journal file name (empty = csvFileName with suffix _journal)
+const std::string journalHeader = "seed, time, slice, parameter, old, new";
 
-std::vector<uint32_t> destPorts(nStaA+nStaB+nStaC);
 
-double probErr[2][nStaA+nStaB+nStaC]; // Pe on last T=[t0-T, t0] and on previous T=[t0-2T, t0-T]
+ResultWriter writer;  // rows of the .csv file
+bool asyncWriter = 0; // 0 the rows are written by the simulation thread, 1 by a background thread
 
 
 // function to define the parameters which can be set when the script is called
@@ -158,12 +204,31 @@ void configure (int argc, char *argv[])
   CommandLine cmd;
   cmd.AddValue ("payloadSize", "Payload size in bytes", payloadSize);
   cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
+  cmd.AddValue ("controlInterval", "Control period in seconds", controlInterval);
+  cmd.AddValue ("verbose", "Print the Pe of every STA at each control tick", verbose);
   cmd.AddValue ("seed", "Seed", seed);
+  cmd.AddValue ("lastSeed", "Run the seeds seed, ..., lastSeed in a batch", lastSeed);
+  cmd.AddValue ("jobs", "Number of seeds of a batch run in parallel", jobs);
+  cmd.AddValue ("keepShards", "Write one shard per seed and do not merge them", keepShards);
+  cmd.AddValue ("variantFile", "File with one variant per line (name=value ...) forked at the start of the traffic", variantFile);
+  cmd.AddValue ("controller", "Shared library of the slice controller (empty = built-in)", controllerLibrary);
+  cmd.AddValue ("controllerArgs", "Arguments of the slice controller of the library", controllerArgs);
+  cmd.AddValue ("asyncController", "Run the controller on a worker thread while the simulation goes on", asyncController);
+  cmd.AddValue ("decisionDelay", "Delay of the decisions of the worker [s] (negative = measured compute time)", decisionDelay);
+  cmd.AddValue ("asyncPollStep", "Simulation step between two checks of the worker [s]", asyncPollStep);
   cmd.AddValue ("csvFileName", "Name of the .csv file", csvFileName);
   cmd.AddValue ("band", "AC_5, AX_2.4 or AX_5", band);
   cmd.AddValue ("phyModel", "PHY layer model", phyModel);
   cmd.AddValue ("constantMcs", "0 Minstrel or 1 constant", constantMcs);
   cmd.AddValue ("enablePcap", "Enable/disable pcap file generation", enablePcap);
+  cmd.AddValue ("channelPerSlice", "One spectrum channel per slice (bands must not overlap)", channelPerSlice);
+  cmd.AddValue ("gridStep", "Step of the interpolated AP path loss grid [m] (0 = exact model)", gridStep);
+  cmd.AddValue ("gridFileName", "File of the AP path loss grid", gridFileName);
+  cmd.AddValue ("errorModel", "Error rate model: nist or table", errorModel);
+  cmd.AddValue ("journalFileName", "Name of the .csv file of the applied changes", journalFileName);
+  cmd.AddValue ("asyncWriter", "Write the .csv file from a background thread", asyncWriter);
+  cmd.AddValue ("binFileName", "Name of the columnar binary file (empty = none)", binFileName);
+  cmd.AddValue ("runId", "Run identifier written in the binary file (0 = seed)", runId);
   // Network A
   cmd.AddValue ("channelNumberA", "Channel number A", channelNumberA);
   cmd.AddValue ("channelWidthA", "Channel width A", channelWidthA);
@@ -186,169 +251,353 @@ void configure (int argc, char *argv[])
   cmd.AddValue ("txPowerC", "Transmission power C", txPowerC);
   cmd.AddValue ("dataRateC_fixed", "Data rate C", dataRateC_fixed);
   
-  //cmd.AddValue ("nStaA", "Number Stations A", nStaA);
-  //cmd.AddValue ("nStaB", "Number Stations B", nStaB);
-  //cmd.AddValue ("nStaC", "Number Stations C", nStaC);
+  cmd.AddValue ("nStaA", "Number Stations A", nStaA);
+  cmd.AddValue ("nStaB", "Number Stations B", nStaB);
+  cmd.AddValue ("nStaC", "Number Stations C", nStaC);
+  cmd.AddValue ("dataRateMinA", "Minimum data rate A [Mb/s]", dataRateMinA);
+  cmd.AddValue ("dataRateMaxA", "Maximum data rate A (excluded) [Mb/s]", dataRateMaxA);
+  cmd.AddValue ("dataRateMinB", "Minimum data rate B [Kb/s]", dataRateMinB);
+  cmd.AddValue ("dataRateMaxB", "Maximum data rate B (excluded) [Kb/s]", dataRateMaxB);
+  cmd.AddValue ("dataRateMinC", "Minimum data rate C [Mb/s]", dataRateMinC);
+  cmd.AddValue ("dataRateMaxC", "Maximum data rate C (excluded) [Mb/s]", dataRateMaxC);
+  cmd.AddValue ("historyLength", "Number of control windows kept in the station store", historyLength);
+  cmd.AddValue ("kpiSource", "flowMonitor or trace", kpiSource);
   cmd.Parse (argc, argv);
+  // Every slice needs at least one STA (the controllers size the slices from their STAs)
+  if (nStaA <= 0 || nStaB <= 0 || nStaC <= 0)
+  {
+    std::cout << ERROR << "nStaA, nStaB and nStaC must be positive (" << nStaA << ", " << nStaB << ", " << nStaC << ")!"
+              << ENDC << std::endl;
+    std::exit (1);
+  }
 }
 
 
-// function to set the channel number
-void set_channel_number()
+// function to size the per-station state according to the number of stations
+void allocate_stations()
 {
-  for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberA)); ///NodeList/3/DeviceList 3?
-  for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberB));
-  for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberC));
+  int nSta = nStaA + nStaB + nStaC;
+  dataRateA.assign (nStaA, 0);
+  dataRateB.assign (nStaB, 0);
+  dataRateC.assign (nStaC, 0);
+  rxPacketsA_meas.assign (nStaA, 0);
+  rxPacketsB_meas.assign (nStaB, 0);
+  rxPacketsC_meas.assign (nStaC, 0);
+  pathLoss.assign (nSta, 0);
+  station.Resize (nSta, std::max (historyLength, 2));
+  kpi.Resize (nSta);
 }
 
 
-// function to set the channel width
-void set_channel_width()
+// function to store the handles of one device in the registry of its slice
+void add_slice_device (SliceDevices& slice, Ptr<NetDevice> device)
+{
+  Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice> (device);
+  slice.phy.push_back (wifiDevice->GetPhy ());
+  slice.manager.push_back (DynamicCast<ConstantRateWifiManager> (wifiDevice->GetRemoteStationManager ()));
+  slice.heConfiguration.push_back (wifiDevice->GetHeConfiguration ());
+}
+
+
+// function to build the slice registry, STA devices first and then the AP device of each slice
+void build_slice_registry (std::vector<NetDeviceContainer>& staDeviceA, NetDeviceContainer& apDeviceA,
+                           std::vector<NetDeviceContainer>& staDeviceB, NetDeviceContainer& apDeviceB,
+                           std::vector<NetDeviceContainer>& staDeviceC, NetDeviceContainer& apDeviceC)
 {
   for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthA));
+    add_slice_device (sliceDevices[0], staDeviceA[i].Get (0));
+  add_slice_device (sliceDevices[0], apDeviceA.Get (0));
   for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthB));
+    add_slice_device (sliceDevices[1], staDeviceB[i].Get (0));
+  add_slice_device (sliceDevices[1], apDeviceB.Get (0));
   for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthC));
+    add_slice_device (sliceDevices[2], staDeviceC[i].Get (0));
+  add_slice_device (sliceDevices[2], apDeviceC.Get (0));
 }
 
 
-// function to set the tx power
-void set_tx_power()
+// function to set the channel number of the devices of one slice
+void set_slice_channel_number (SliceDevices& slice, int channelNumber)
 {
-  for (int i = 0; i < nStaA; i++)
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
+    slice.phy[i]->SetChannelNumber (channelNumber);
+}
+
+
+// function to set the channel number
+void set_channel_number()
+{
+  set_slice_channel_number (sliceDevices[0], channelNumberA);
+  set_slice_channel_number (sliceDevices[1], channelNumberB);
+  set_slice_channel_number (sliceDevices[2], channelNumberC);
+}
+
+
+// function to get the width [MHz] a PHY switches to when it is set to channelNumber,
+// according to the channel table of WifiPhy (SetChannelNumber also resets the channel width)
+int default_channel_width (int channelNumber)
+{
+  switch (channelNumber)
   {
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerA));
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerA));
+    case 50: case 114:
+      return 160;
+    case 42: case 58: case 106: case 122: case 138: case 155:
+      return 80;
+    case 38: case 46: case 54: case 62: case 102: case 110: case 118: case 126: case 134: case 142: case 151: case 159:
+      return 40;
+    default:
+      return 20;
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerA));
-  for (int i = 0; i < nStaB; i++)
+}
+
+
+// function to set the channel width of the devices of one slice
+void set_slice_channel_width (SliceDevices& slice, int channelWidth)
+{
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
+    slice.phy[i]->SetChannelWidth (channelWidth);
+}
+
+
+// function to set the channel width
+void set_channel_width()
+{
+  set_slice_channel_width (sliceDevices[0], channelWidthA);
+  set_slice_channel_width (sliceDevices[1], channelWidthB);
+  set_slice_channel_width (sliceDevices[2], channelWidthC);
+}
+
+
+// function to set the tx power of the devices of one slice
+void set_slice_tx_power (SliceDevices& slice, int txPower)
+{
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerB));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerB));
+    slice.phy[i]->SetTxPowerStart (txPower);
+    slice.phy[i]->SetTxPowerEnd (txPower);
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerB));
-  for (int i = 0; i < nStaC; i++)
+}
+
+
+// function to set the tx power
+void set_tx_power()
+{
+  set_slice_tx_power (sliceDevices[0], txPowerA);
+  set_slice_tx_power (sliceDevices[1], txPowerB);
+  set_slice_tx_power (sliceDevices[2], txPowerC);
+}
+
+
+// function to set the guard interval of the devices of one slice
+void set_slice_guard_interval (SliceDevices& slice, int gi)
+{
+  for (std::size_t i = 0; i < slice.heConfiguration.size (); i++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerC));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerC));
+    if (slice.heConfiguration[i] != 0)
+      slice.heConfiguration[i]->SetGuardInterval (NanoSeconds (gi));
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerC));
 }
 
 
 // function to set the guard interval
 void set_guard_interval()
 {
-  for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giA)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giA)));
-  for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giB)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giB)));
-  for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giC)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giC)));
+  set_slice_guard_interval (sliceDevices[0], giA);
+  set_slice_guard_interval (sliceDevices[1], giB);
+  set_slice_guard_interval (sliceDevices[2], giC);
+}
+
+
+// function to set the modulation and coding scheme of the devices of one slice
+void set_slice_mcs (SliceDevices& slice, int mcs)
+{
+  std::ostringstream oss;
+  oss << "HeMcs" << mcs;
+  WifiModeValue mode (WifiMode (oss.str ()));
+  for (std::size_t i = 0; i < slice.manager.size (); i++)
+  {
+    if (slice.manager[i] != 0)
+    {
+      slice.manager[i]->SetAttribute ("DataMode", mode);
+      slice.manager[i]->SetAttribute ("ControlMode", mode);
+    }
+  }
 }
 
 
 // function to set the modulation and coding scheme
 void set_mcs()
 {
-  std::ostringstream ossA;
-  ossA << "HeMcs" << mcsA;
-  for (int i = 0; i < nStaA; i++)
+  set_slice_mcs (sliceDevices[0], mcsA);
+  set_slice_mcs (sliceDevices[1], mcsB);
+  set_slice_mcs (sliceDevices[2], mcsC);
+}
+
+
+// function to collect the configuration computed for each slice
+void get_config (SliceConfig config[3])
+{
+  SliceConfig computed[3] = {
+    {channelNumberA, channelWidthA, giA, mcsA, txPowerA},
+    {channelNumberB, channelWidthB, giB, mcsB, txPowerB},
+    {channelNumberC, channelWidthC, giC, mcsC, txPowerC}
+  };
+  for (int s = 0; s < 3; s++)
+    config[s] = computed[s];
+}
+
+
+// function to set the configuration of each slice
+void set_config (const SliceConfig config[3])
+{
+  channelNumberA = config[0].channelNumber;
+  channelWidthA = config[0].channelWidth;
+  giA = config[0].gi;
+  mcsA = config[0].mcs;
+  txPowerA = config[0].txPower;
+  channelNumberB = config[1].channelNumber;
+  channelWidthB = config[1].channelWidth;
+  giB = config[1].gi;
+  mcsB = config[1].mcs;
+  txPowerB = config[1].txPower;
+  channelNumberC = config[2].channelNumber;
+  channelWidthC = config[2].channelWidth;
+  giC = config[2].gi;
+  mcsC = config[2].mcs;
+  txPowerC = config[2].txPower;
+}
+
+
+// function to warn when the bands of two slices overlap while each slice has its own channel,
+// since their frames would then not interfere as they do on a single channel
+void check_slice_bands()
+{
+  if (!channelPerSlice || phyModel != "spectrum")
+    return;
+  for (int s = 0; s < 3; s++)
   {
-    Config::Set ("/NodeList/" + std::to_string(i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossA.str ()));
-    Config::Set ("/NodeList/" + std::to_string(i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossA.str ()));
-  }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossA.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossA.str ()));
-  std::ostringstream ossB;
-  ossB << "HeMcs" << mcsB;
-  for (int i = 0; i < nStaB; i++)
+    for (int t = s + 1; t < 3; t++)
+    {
+      double distance = 5 * std::abs (appliedConfig[s].channelNumber - appliedConfig[t].channelNumber); // MHz
+      if (distance < (appliedConfig[s].channelWidth + appliedConfig[t].channelWidth) / 2.0)
+        std::cout << WARNING << "Slices " << (char) ('A' + s) << " and " << (char) ('A' + t)
+                  << " overlap but use separate channels!" << ENDC << std::endl;
+    }
+  }
+}
+
+
+// function to store the configuration currently applied to the devices of each slice
+void store_applied_config()
+{
+  get_config (appliedConfig);
+  check_slice_bands();
+}
+
+
+// function to record a change applied to a slice in the journal
+void journal_change (int slice, std::string parameter, int oldValue, int newValue)
+{
+  journal << seed << "," << Simulator::Now ().GetSeconds () << "," << (char) ('A' + slice) << ","
+          << parameter << "," << oldValue << "," << newValue << std::endl;
+}
+
+
+// function to apply only the parameters which differ from the configuration applied to each slice
+void apply_channels()
+{
+  SliceConfig config[3];
+  get_config (config);
+  for (int s = 0; s < 3; s++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossB.str ()));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossB.str ()));
-  }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/1/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossB.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/1/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossB.str ()));
-  std::ostringstream ossC;
-  ossC << "HeMcs" << mcsC;
-  for (int i = 0; i < nStaC; i++)
+    bool numberChanged = config[s].channelNumber != appliedConfig[s].channelNumber;
+    if (numberChanged)
+    {
+      set_slice_channel_number (sliceDevices[s], config[s].channelNumber);
+      journal_change (s, "channelNumber", appliedConfig[s].channelNumber, config[s].channelNumber);
+    }
+    // The channel switch has reset the width to the default one of the new channel
+    if (config[s].channelWidth != appliedConfig[s].channelWidth
+        || (numberChanged && config[s].channelWidth != default_channel_width (config[s].channelNumber)))
+    {
+      set_slice_channel_width (sliceDevices[s], config[s].channelWidth);
+      if (config[s].channelWidth != appliedConfig[s].channelWidth)
+        journal_change (s, "channelWidth", appliedConfig[s].channelWidth, config[s].channelWidth);
+    }
+    if (config[s].txPower != appliedConfig[s].txPower)
+    {
+      set_slice_tx_power (sliceDevices[s], config[s].txPower);
+      journal_change (s, "txPower", appliedConfig[s].txPower, config[s].txPower);
+    }
+    if (config[s].gi != appliedConfig[s].gi)
+    {
+      set_slice_guard_interval (sliceDevices[s], config[s].gi);
+      journal_change (s, "gi", appliedConfig[s].gi, config[s].gi);
+    }
+    if (config[s].mcs != appliedConfig[s].mcs)
+    {
+      set_slice_mcs (sliceDevices[s], config[s].mcs);
+      journal_change (s, "mcs", appliedConfig[s].mcs, config[s].mcs);
+    }
+    appliedConfig[s] = config[s];
+  }
+  check_slice_bands();
+}
+
+
+// function to set the default journal file name (csvFileName with suffix _journal)
+void set_journal_file_name()
+{
+  if (journalFileName == "")
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossC.str ()));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossC.str ()));
+    journalFileName = csvFileName;
+    if (journalFileName.size () > 4 && journalFileName.substr (journalFileName.size () - 4) == ".csv")
+      journalFileName.erase (journalFileName.size () - 4);
+    journalFileName += "_journal.csv";
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/2/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossC.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/2/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossC.str ()));
+}
+
+
+// function to write the journal of the applied changes
+void write_journal()
+{
+  set_journal_file_name();
+  bool newFile = !std::ifstream (journalFileName.c_str ()).good ();
+  std::ofstream out (journalFileName.c_str (), std::ios::app);
+  if (newFile)
+    out << journalHeader << std::endl;
+  out << journal.str ();
+  out.close ();
+}
+
+
+// function called by the Tx trace of the OnOff client of station sta
+void kpi_tx (int sta, Ptr<const Packet> packet)
+{
+  kpi.Tx (sta, packet);
+}
+
+
+// function called by the Rx trace of the UdpServer of station sta
+void kpi_rx (int sta, Ptr<const Packet> packet)
+{
+  KpiTimestampTag tag;
+  double delay;
+  kpi.Rx (sta, packet, tag, delay);
+}
+
+
+BinWriter binWriter; // columnar binary output (binFileName)
+
+
+// function to write one chunk of the binary file
+void write_bin_chunk (BinChunkKind kind, int tick, double time)
+{
+  SliceConfig config[3];
+  get_config (config);
+  int nSta[3] = {nStaA, nStaB, nStaC};
+  const std::vector<int>* dataRate[3] = {&dataRateA, &dataRateB, &dataRateC};
+  binWriter.WriteChunk (runId, seed, kind, tick, time, nSta, config, dataRate, station);
 }
 
 
@@ -373,182 +622,465 @@ void new_application (uint16_t& index, NodeContainer staNodes, NodeContainer apN
   clientApp = client.Install (staNodes.Get (index-1));
   clientApp.Start (Seconds (1.0));
   clientApp.Stop (Seconds (simulationTime + 1));
+  if (kpiSource == "trace")
+  {
+    int sta = index - 1;
+    clientApp.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&kpi_tx, sta));
+    serverApp.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&kpi_rx, sta));
+  }
   index ++;
 }
 
 
+// function to read the KPIs of a new control window into the station store
+void read_stats()
+{
+  station.Advance ();
+  if (kpiSource == "trace")
+    station.ReadCollector (kpi);
+  else
+    station.ReadFlowStats (flowMonitor, flowHelper, flowStation, 5001);
+  station.ComputeProbErr ();
+}
+
+
+LossCache lossCache; // path loss from each STA to the AP
+
+
+// Built-in slice controller, used when no controller library is given
+class UserSliceController : public SliceController
+{
+public:
+  virtual void Initialize (const KpiSnapshot& kpi, SliceConfig config[3]);
+  virtual void Update (const KpiSnapshot& kpi, SliceConfig config[3]);
+};
+
+
+void UserSliceController::Initialize (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  /*
+  *
+  *
+  * PLACE HERE YOUR CODE TO COMPUTE THE INITIAL CHANNELS' PROPERTIES
+  *
+  * INPUTS:     - kpi.rxPower, kpi.loss
+  *             - any characteristic of the scenario (e.g. kpi.nSta and kpi.dataRateSum of slices A, B and C)
+  *             - config: configuration applied to slices A, B and C
+  *
+  * OUTPUTS:    - config[0]: channelWidth, channelNumber, gi, mcs, txPower of slice A
+  *             - config[1]: channelWidth, channelNumber, gi, mcs, txPower of slice B
+  *             - config[2]: channelWidth, channelNumber, gi, mcs, txPower of slice C
+  *
+  *
+  */
+}
+
+
+void UserSliceController::Update (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  /*
+  *
+  *
+  * PLACE HERE YOUR CODE TO UPDATE THE CHANNELS' PROPERTIES
+  *
+  * INPUTS:     - kpi.rxPower, kpi.txPackets[k], kpi.rxPackets[k], kpi.latency[k], kpi.probErr[k]
+  *               on the window k = 0, ..., kpi.historyLength-1 windows before the last one
+  *             - config: previous values of the channel properties
+  *             - any characteristic of the scenario (e.g. kpi.nSta and kpi.dataRateSum of slices A, B and C)
+  *
+  * OUTPUTS:    - config[0]: channelWidth, channelNumber, gi, mcs, txPower of slice A
+  *             - config[1]: channelWidth, channelNumber, gi, mcs, txPower of slice B
+  *             - config[2]: channelWidth, channelNumber, gi, mcs, txPower of slice C
+  *
+  *
+  */
+}
+
+
+SliceController* sliceController = 0; // controller computing the slice configurations
+KpiSnapshot snapshot;                 // KPIs handed to the controller
+std::vector<int> snapshotDataRate;    // data rates of the STAs A, B and C
+std::vector<const uint32_t*> snapshotTxPackets;
+std::vector<const uint32_t*> snapshotRxPackets;
+std::vector<const double*> snapshotLatency;
+std::vector<const double*> snapshotProbErr;
+
+
+// function to create the slice controller, the built-in one or the one of controllerLibrary
+// The library is never unloaded, since the code of its controller lives in it. Returns 0 if it cannot be loaded
+int load_controller()
+{
+  delete sliceController;
+  sliceController = 0;
+  if (controllerLibrary == "")
+  {
+    sliceController = new UserSliceController ();
+    return 1;
+  }
+  void* library = dlopen (controllerLibrary.c_str (), RTLD_NOW | RTLD_LOCAL);
+  if (!library)
+  {
+    std::cout << ERROR << "Cannot load " << controllerLibrary << ": " << dlerror () << ENDC << std::endl;
+    return 0;
+  }
+  CreateSliceControllerFunction create = (CreateSliceControllerFunction) dlsym (library, "CreateSliceController");
+  if (create)
+    sliceController = create (controllerArgs.c_str ());
+  if (!sliceController)
+  {
+    std::cout << ERROR << "No controller created by " << controllerLibrary << "!" << ENDC << std::endl;
+    return 0;
+  }
+  std::cout << OKBLUE << "Slice controller: " << controllerLibrary << " " << controllerArgs << ENDC << std::endl;
+  return 1;
+}
+
+
+// function to fill the snapshot handed to the controller from the station store
+// The rx power of each STA must have been computed with the applied tx power
+void take_snapshot (int tick)
+{
+  int nSta = nStaA + nStaB + nStaC;
+  if (snapshotDataRate.empty ())
+  {
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateA.begin (), dataRateA.end ());
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateB.begin (), dataRateB.end ());
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateC.begin (), dataRateC.end ());
+  }
+  for (int i = 0; i < nSta; i++)
+    pathLoss[i] = lossCache.Get (i);
+  snapshotTxPackets.resize (station.historyLength);
+  snapshotRxPackets.resize (station.historyLength);
+  snapshotLatency.resize (station.historyLength);
+  snapshotProbErr.resize (station.historyLength);
+  for (int k = 0; k < station.historyLength; k++)
+  {
+    snapshotTxPackets[k] = station.TxPackets (k);
+    snapshotRxPackets[k] = station.RxPackets (k);
+    snapshotLatency[k] = station.Latency (k);
+    snapshotProbErr[k] = station.ProbErr (k);
+  }
+  snapshot.time = Simulator::Now ().GetSeconds ();
+  snapshot.tick = tick;
+  snapshot.nSta[0] = nStaA;
+  snapshot.nSta[1] = nStaB;
+  snapshot.nSta[2] = nStaC;
+  snapshot.dataRateSum[0] = dataRateSumA;
+  snapshot.dataRateSum[1] = dataRateSumB;
+  snapshot.dataRateSum[2] = dataRateSumC;
+  snapshot.dataRate = snapshotDataRate.data ();
+  snapshot.x = station.x.data ();
+  snapshot.y = station.y.data ();
+  snapshot.loss = pathLoss.data ();
+  snapshot.rxPower = station.rxPower.data ();
+  snapshot.historyLength = station.historyLength;
+  snapshot.txPackets = snapshotTxPackets.data ();
+  snapshot.rxPackets = snapshotRxPackets.data ();
+  snapshot.latency = snapshotLatency.data ();
+  snapshot.probErr = snapshotProbErr.data ();
+  for (int s = 0; s < 3; s++)
+    snapshot.applied[s] = appliedConfig[s];
+}
+
+
+// function to get the initial configuration of the slices from the controller
+void initialize_controller()
+{
+  // Compute Inputs: rx power through the path loss [dB] with the current tx power
+  for (int i = 0; i < nStaA; i++)
+    station.rxPower[i] = txPowerA - lossCache.Get (i);
+  for (int i = 0; i < nStaB; i++)
+    station.rxPower[nStaA+i] = txPowerB - lossCache.Get (nStaA+i);
+  for (int i = 0; i < nStaC; i++)
+    station.rxPower[nStaA+nStaB+i] = txPowerC - lossCache.Get (nStaA+nStaB+i);
+
+  // Compute Outputs: channel number, channel width, guard interval, mcs, tx power
+  take_snapshot (0);
+  SliceConfig config[3];
+  get_config (config);
+  sliceController->Initialize (snapshot, config);
+  set_config (config);
+}
+
+
+// Decision of the controller computed by a worker thread (asyncController), while the simulation goes on.
+// The simulation only checks every asyncPollStep whether the worker has finished, without ever waiting for it:
+// the decision is applied decisionDelay after the KPIs were sampled or, with a negative decisionDelay, at sample
+// time plus compute time. When the simulation has already gone past that time (it runs faster than the worker),
+// the decision is applied as soon as it is seen. The output of the controller is printed when it is applied
+AsyncDecision decision;
+
+
+// function to apply the decision of the worker
+void apply_decision()
+{
+  decision.Join ();
+  decision.pending = 0;
+  std::cout << "At time " << Simulator::Now ().GetSeconds () << "s the decision of tick " << decision.tick
+            << " is applied (compute time " << decision.computeTime << "s)" << std::endl;
+  set_config (decision.config);
+  apply_channels();
+}
+
+
+// function to check every asyncPollStep whether the worker has finished, and then to apply its decision
+// at its time or at once if that time is past
+void poll_decision()
+{
+  if (!decision.Ready ())
+  {
+    Simulator::Schedule (Seconds (asyncPollStep), &poll_decision);
+    return;
+  }
+  Time apply = decision.sampleTime + Seconds (decisionDelay >= 0 ? decisionDelay : decision.computeTime);
+  Simulator::Schedule (Max (apply - Simulator::Now (), Seconds (0)), &apply_decision);
+}
+
+
+// function to start the worker on the snapshot of tick
+void request_decision (int tick)
+{
+  if (decision.pending)
+  {
+    std::cout << "The decision of tick " << decision.tick << " is still pending, tick " << tick << " is not evaluated" << std::endl;
+    return;
+  }
+  SliceConfig config[3];
+  get_config (config);
+  decision.Start (sliceController, snapshot, config, tick);
+  Simulator::Schedule (Seconds (std::max (decisionDelay, 0.0)), &poll_decision);
+}
+
+
 // function to update channel widths, channel numbers, GIs, MCSs, and Ptxs for each slice.
-void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
+// Tick i ends the control window ((i-2) T, (i-1) T] of traffic, which starts at 1 s, and schedules tick i+1
+void update_channels (int i, Ptr<BuildingsPropagationLossModel> lossModel,
                       NodeContainer staNodes, NodeContainer apNode)
 {
-  std::cout << "At time " << i << "s update_channels is called" << std::endl;
+  std::cout << "At time " << Simulator::Now ().GetSeconds () << "s update_channels is called" << std::endl;
 
   // Compute Inputs: rx power through the path loss [dB] (meaningful only when mobility is involved), # of tx packets, # of rx packets and latency
 
   for (int i = 0; i < nStaA; i++)
   {
-    rxPower[i] = txPowerA - lossModel->GetLoss (staNodes.Get(i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power A: " << rxPower[i] << std::endl;
+    station.rxPower[i] = txPowerA - lossCache.Get (i);
+    //std::cout << "Received power A: " << station.rxPower[i] << std::endl;
   }
   for (int i = 0; i < nStaB; i++)
   {
-    rxPower[nStaA+i] = txPowerB - lossModel->GetLoss (staNodes.Get(nStaA+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power B: " << rxPower[nStaA+i] << std::endl;
+    station.rxPower[nStaA+i] = txPowerB - lossCache.Get (nStaA+i);
+    //std::cout << "Received power B: " << station.rxPower[nStaA+i] << std::endl;
   }
   for (int i = 0; i < nStaC; i++)
   {
-    rxPower[nStaA+nStaB+i] = txPowerC - lossModel->GetLoss (staNodes.Get(nStaA+nStaB+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power C: " << rxPower[nStaA+nStaB+i] << std::endl;
-  }
-  //flowMonitor->CheckForLostPackets ();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
-  FlowMonitor::FlowStatsContainer stats = flowMonitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
-  {
-    txPackets_unsort[i->first-1] = i->second.txPackets;
-    rxPackets_unsort[i->first-1] = i->second.rxPackets;
-    latency_unsort[i->first-1] = i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets;
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    destPorts[i->first-1] = t.destinationPort;
-    //std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << "," << destPorts[i->first-1] << ")\n";
-    //std::cout << "  Tx Packets: " << totTxPackets[i->first-1] << "\n";
-    //std::cout << "  Rx Packets: " << totRxPackets[i->first-1] << "\n";
-    //std::cout << "  Delay Sum: " << totDelay[i->first-1] << "\n";
-    //std::cout << "  Delay Sum MS: " << i->second.delaySum.ToDouble(Time::MS) << "\n";
-    //std::cout << "  Delay: " << i->second.delaySum / i->second.rxPackets << "\n";
-    //std::cout << "  Delay MS: " << i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets << "\n";
-  }
-  // Shift txPackets, rxPackets, latency and probErr
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
-  {
-  	txPackets[1][i] = txPackets[0][i];
-  	rxPackets[1][i] = rxPackets[0][i];
-  	latency[1][i] = latency[0][i];
-  	probErr[1][i] = probErr[0][i];
+    station.rxPower[nStaA+nStaB+i] = txPowerC - lossCache.Get (nStaA+nStaB+i);
+    //std::cout << "Received power C: " << station.rxPower[nStaA+nStaB+i] << std::endl;
   }
-  // Compute txPackets, rxPackets, latency and probErr
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  read_stats();
+  if (verbose)
   {
-    txPackets[0][destPorts[i]-5001] = txPackets_unsort[i];
-    rxPackets[0][destPorts[i]-5001] = rxPackets_unsort[i];
-    latency[0][destPorts[i]-5001] = latency_unsort[i];
+    for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+    {
+      std::cout << "Error Prob: " << station.ProbErr (0)[i] << std::endl;
+    }
   }
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+
+  // Compute Outputs: channel width, channel number, guard interval, mcs, tx power
+  take_snapshot (i);
+  if (asyncController)
+    request_decision (i); // applied later by apply_decision
+  else
   {
-  	// probErr[0][i] = (txPackets[0][i] - rxPackets[0][i]) / (double)txPackets[0][i];
-    probErr[0][i] = ((txPackets[0][i]-txPackets[1][i]) - (rxPackets[0][i]-rxPackets[1][i])) / (double)(txPackets[0][i]-txPackets[1][i]);
-    std::cout << "Error Prob: " << probErr[0][i] << std::endl;
+    SliceConfig config[3];
+    get_config (config);
+    sliceController->Update (snapshot, config);
+    set_config (config);
   }
 
-  // Compute Outputs: channel width, channel number, guard interval, mcs, tx power
-  
-  /*
-  *
-  *
-  * PLACE HERE YOUR CODE TO UPDATE THE CHANNELS' PROPERTIES
-  *
-  * INPUTS:     - rxPower, txPackets, rxPackets, latency, probErr
-  *             - previous values of the channel properties
-  *             - any characteristic of the scenario (e.g. nStaX and dataRateSumX, where X is A, B or C)
-  *
-  * OUTPUTS:    - channelWidthA, channelNumberA, giA, mcsA, txPowerA
-  *             - channelWidthB, channelNumberB, giB, mcsB, txPowerB
-  *             - channelWidthC, channelNumberC, giC, mcsC, txPowerC
-  *
-  *
-  */
-  
   // Set Outputs
-  set_channel_number();
-  set_channel_width();
-  set_tx_power();
-  set_guard_interval();
-  set_mcs();
+  apply_channels();
 
   // Write file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
+  std::ostream& out = writer.Buffer ();
   out << "channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
   out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
   out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
   out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
   for (int i = 0; i < nStaA; i++)
   {
-    out << dataRateA[i] << "," << x[i] << "," << y[i] << ","
-    << txPackets[0][i] << "," << rxPackets[0][i] << "," << latency[0][i]
+    out << dataRateA[i] << "," << station.x[i] << "," << station.y[i] << ","
+    << station.TxPackets (0)[i] << "," << station.RxPackets (0)[i] << "," << station.Latency (0)[i]
     << std::endl;
   }
   for (int i = 0; i < nStaB; i++)
   {
-    out << dataRateB[i] << "," << x[nStaA+i] << "," << y[nStaA+i] << ","
-    << txPackets[0][nStaA+i] << "," << rxPackets[0][nStaA+i] << "," << latency[0][nStaA+i] << std::endl;
+    out << dataRateB[i] << "," << station.x[nStaA+i] << "," << station.y[nStaA+i] << ","
+    << station.TxPackets (0)[nStaA+i] << "," << station.RxPackets (0)[nStaA+i] << "," << station.Latency (0)[nStaA+i] << std::endl;
   }
   for (int i = 0; i < nStaC; i++)
   {
-    out << dataRateC[i] << "," << x[nStaA+nStaB+i] << "," << y[nStaA+nStaB+i] << ","
-    << txPackets[0][nStaA+nStaB+i] << "," << rxPackets[0][nStaA+nStaB+i] << "," << latency[0][nStaA+nStaB+i] << std::endl;
+    out << dataRateC[i] << "," << station.x[nStaA+nStaB+i] << "," << station.y[nStaA+nStaB+i] << ","
+    << station.TxPackets (0)[nStaA+nStaB+i] << "," << station.RxPackets (0)[nStaA+nStaB+i] << "," << station.Latency (0)[nStaA+nStaB+i] << std::endl;
   }
-  out.close ();
+  writer.Commit ();
+  if (binWriter.IsOpen ())
+    write_bin_chunk (BIN_UPDATE, i, Simulator::Now ().GetSeconds ());
+
+  // Next control tick, until the end of the traffic
+  if (1 + i * controlInterval <= simulationTime + 1e-9)
+    Simulator::Schedule (Seconds (controlInterval), &update_channels, i + 1, lossModel, staNodes, apNode);
 }
 
 
 // function to compute the initial channels' properties for each slice
-void compute_channels (Ptr<HybridBuildingsPropagationLossModel> lossModel,
+void compute_channels (Ptr<BuildingsPropagationLossModel> lossModel,
                       NodeContainer staNodes, NodeContainer apNode)
 {
   std::cout << "At the beginning compute_channels is called" << std::endl;
 
-  // Compute Inputs: rx power through the path loss [dB] (meaningful only when mobility is involved)
+  // Compute Inputs: rx power through the path loss [dB] with the maximum power
   txPowerA = 20; // Maximum power
   txPowerB = 20; // Maximum power
   txPowerC = 20; // Maximum power
 
-  for (int i = 0; i < nStaA; i++)
-  {
-    rxPower[i] = txPowerA - lossModel->GetLoss (staNodes.Get(i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power A: " << rxPower[i] << std::endl;
-  }
-  for (int i = 0; i < nStaB; i++)
-  {
-    rxPower[nStaA+i] = txPowerB - lossModel->GetLoss (staNodes.Get(nStaA+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power B: " << rxPower[nStaA+i] << std::endl;
-  }
-  for (int i = 0; i < nStaC; i++)
-  {
-    rxPower[nStaA+nStaB+i] = txPowerC - lossModel->GetLoss (staNodes.Get(nStaA+nStaB+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power C: " << rxPower[nStaA+nStaB+i] << std::endl;
-  }
-  
   // Compute Outputs: channel width, channel number, guard interval, mcs, tx power
-  
-  /*
-  *
-  *
-  * PLACE HERE YOUR CODE TO COMPUTE THE INITIAL CHANNELS' PROPERTIES
-  *
-  * INPUTS:     - rxPower
-  *             - any characteristic of the scenario (e.g. nStaX and dataRateSumX, where X is A, B or C)
-  *
-  * OUTPUTS:    - channelWidthA, channelNumberA, giA, mcsA, txPowerA
-  *             - channelWidthB, channelNumberB, giB, mcsB, txPowerB
-  *             - channelWidthC, channelNumberC, giC, mcsC, txPowerC
-  *
-  *
-  */
+  initialize_controller();
 
   // Set Outputs
-  set_channel_number();
-  set_channel_width();
-  set_tx_power();
-  set_guard_interval();
-  set_mcs();
+  apply_channels();
 
   // Write file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
+  std::ostream& out = writer.Buffer ();
   out << "init_channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
   out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
   out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
   out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
-  out.close ();
+  writer.Commit ();
+  if (binFileName != "")
+    write_bin_chunk (BIN_INIT, 0, Simulator::Now ().GetSeconds ());
+}
+
+
+// function to get the name of the output file of a variant: name with suffix before the extension
+std::string variant_file_name (std::string fileName, std::string suffix)
+{
+  std::size_t dot = fileName.find_last_of ('.');
+  if (dot == std::string::npos || fileName.find ('/', dot) != std::string::npos)
+    return fileName + suffix;
+  return fileName.substr (0, dot) + suffix + fileName.substr (dot);
+}
+
+
+// Options which a variant may override: the ones read after the start of the traffic
+const std::vector<std::string> overridableOptions = {
+  "channelNumberA", "channelWidthA", "mcsA", "giA", "txPowerA",
+  "channelNumberB", "channelWidthB", "mcsB", "giB", "txPowerB",
+  "channelNumberC", "channelWidthC", "mcsC", "giC", "txPowerC",
+  "controller", "controllerArgs", "asyncController", "decisionDelay", "verbose"
+};
+
+
+// function to check that every override of a line (name=value ...) sets one of the overridable options,
+// since the others (topology, traffic, ...) have already been used
+void check_overrides (std::string line)
+{
+  std::istringstream tokens (line);
+  std::string token;
+  while (tokens >> token)
+  {
+    std::string name = token.substr (0, token.find ('='));
+    if (std::find (overridableOptions.begin (), overridableOptions.end (), name) == overridableOptions.end ())
+    {
+      std::cout << ERROR << "Option " << name << " cannot be overridden (" << line << ")!" << ENDC << std::endl;
+      std::exit (1);
+    }
+  }
+}
+
+
+// function to start the variants listed in variantFile, called when the traffic starts.
+// Topology, association and initial channels are shared: the process forks once per variant and
+// each child re-parses the command line with the overrides of its line (name=value ...), applies the
+// slice configuration and runs the rest of the simulation, writing to <csvFileName>_v<k>.
+// Only the options read after the start of the traffic (overridableOptions) can be overridden.
+// A variant selecting another controller (controller, controllerArgs) starts from the configuration of its Initialize.
+// The parent waits for the variants (up to jobs at the same time) and exits
+void warm_start()
+{
+  std::ifstream in (variantFile.c_str ());
+  if (!in.good ())
+  {
+    std::cout << ERROR << "Cannot read " << variantFile << "!" << ENDC << std::endl;
+    std::exit (1);
+  }
+  std::vector<std::string> variants;
+  std::string line;
+  while (std::getline (in, line))
+  {
+    std::size_t first = line.find_first_not_of (" \t");
+    if (first != std::string::npos && line[first] != '#') // skip empty lines and comments
+      variants.push_back (line);
+  }
+  for (std::size_t k = 0; k < variants.size (); k++)
+    check_overrides (variants[k]);
+  std::cout << OKBLUE << "Warm start at " << Simulator::Now ().GetSeconds () << "s: "
+            << variants.size () << " variant(s)" << ENDC << std::endl;
+
+  int running = 0, failed = 0;
+  for (int k = 1; k <= (int) variants.size (); k++)
+  {
+    if (running == std::max (jobs, 1))
+    {
+      failed += wait_seed();
+      running--;
+    }
+    pid_t pid = fork ();
+    if (pid < 0)
+    {
+      std::cout << ERROR << "Cannot fork variant " << k << "!" << ENDC << std::endl;
+      failed++;
+      break;
+    }
+    if (pid == 0)
+    {
+      // Overrides of the variant
+      std::istringstream tokens (variants[k-1]);
+      std::vector<std::string> args (1, "variant");
+      std::string token;
+      while (tokens >> token)
+        args.push_back ("--" + token);
+      std::vector<char*> argv;
+      for (std::size_t j = 0; j < args.size (); j++)
+        argv.push_back (&args[j][0]);
+      std::string parentLibrary = controllerLibrary, parentArgs = controllerArgs;
+      configure (argv.size (), argv.data ());
+      std::cout << OKBLUE << "Variant " << k << ": " << variants[k-1] << ENDC << std::endl;
+      if (controllerLibrary != parentLibrary || controllerArgs != parentArgs)
+      {
+        if (!load_controller())
+          std::exit (1);
+        initialize_controller();
+      }
+
+      // Output files of the variant
+      std::string suffix = "_v" + std::to_string (k);
+      set_journal_file_name();
+      csvFileName = variant_file_name (csvFileName, suffix);
+      journalFileName = variant_file_name (journalFileName, suffix);
+      writer.Open (csvFileName, asyncWriter);
+      if (binFileName != "")
+      {
+        binFileName = variant_file_name (binFileName, suffix);
+        binWriter.Open (binFileName, asyncWriter);
+      }
+      apply_channels();
+      return;
+    }
+    running++;
+  }
+  for (; running > 0; running--)
+    failed += wait_seed();
+  std::exit (failed > 0);
 }
 
 
@@ -557,14 +1089,37 @@ int main (int argc, char *argv[])
 {
   // Define CMD commands
   configure(argc, argv);
+  if (lastSeed > seed || keepShards)
+  {
+    set_journal_file_name();
+    std::vector<SeedOutput> outputs = {{&csvFileName, 0},
+                                       {&journalFileName, journalHeader.size () + 1},
+                                       {&binFileName, BinWriter::HeaderSize ()}};
+    int failed = fork_seeds (seed, lastSeed, jobs, keepShards, outputs);
+    if (failed >= 0)
+      return failed > 0;
+  }
+  allocate_stations();
+  if (!load_controller())
+    return 1;
+  // With variants the files are opened by each variant, after the warm start
+  if (variantFile == "")
+    writer.Open (csvFileName, asyncWriter);
+  if (binFileName != "")
+  {
+    if (runId == 0)
+      runId = seed;
+    if (variantFile == "")
+      binWriter.Open (binFileName, asyncWriter);
+  }
 
   // Set the PRNG seed
   RngSeedManager::SetSeed (seed);
 
   // Set random throughput for each flow in the the 3 slices
   Ptr<UniformRandomVariable> dataRateA_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateA_ptr->SetAttribute ("Min", DoubleValue (80));
-  dataRateA_ptr->SetAttribute ("Max", DoubleValue (101));
+  dataRateA_ptr->SetAttribute ("Min", DoubleValue (dataRateMinA));
+  dataRateA_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxA));
   std::vector<std::string> dataRateA_str(nStaA);
   for (int i = 0; i < nStaA; i++)
   {
@@ -572,8 +1127,8 @@ int main (int argc, char *argv[])
     dataRateA_str[i] = std::to_string(dataRateA[i]) + "Mb/s";
   }
   Ptr<UniformRandomVariable> dataRateB_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateB_ptr->SetAttribute ("Min", DoubleValue (30));
-  dataRateB_ptr->SetAttribute ("Max", DoubleValue (51));
+  dataRateB_ptr->SetAttribute ("Min", DoubleValue (dataRateMinB));
+  dataRateB_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxB));
   std::vector<std::string> dataRateB_str(nStaB);
   for (int i = 0; i < nStaB; i++)
   {
@@ -581,8 +1136,8 @@ int main (int argc, char *argv[])
     dataRateB_str[i] = std::to_string(dataRateB[i]) + "Kb/s";
   }
   Ptr<UniformRandomVariable> dataRateC_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateC_ptr->SetAttribute ("Min", DoubleValue (20));
-  dataRateC_ptr->SetAttribute ("Max", DoubleValue (41));
+  dataRateC_ptr->SetAttribute ("Min", DoubleValue (dataRateMinC));
+  dataRateC_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxC));
   std::vector<std::string> dataRateC_str(nStaC);
   for (int i = 0; i < nStaC; i++)
   {
@@ -599,8 +1154,8 @@ int main (int argc, char *argv[])
   y_ptr->SetAttribute ("Max", DoubleValue (y_max));
   for (int i = 0; i < nStaA+nStaB+nStaC; i++)
   {
-    x[i] = x_ptr->GetValue ();
-    y[i] = y_ptr->GetValue ();
+    station.x[i] = x_ptr->GetValue ();
+    station.y[i] = y_ptr->GetValue ();
   }
 
   // Compute Channels according to initialization algorithm
@@ -620,17 +1175,45 @@ int main (int argc, char *argv[])
   // Create a phy helper
   SpectrumWifiPhyHelper spectrumPhy = SpectrumWifiPhyHelper::Default ();
   YansWifiPhyHelper yansPhy = YansWifiPhyHelper::Default ();
-  Ptr<HybridBuildingsPropagationLossModel> lossModel = CreateObject<HybridBuildingsPropagationLossModel> ();
+  Ptr<BuildingsPropagationLossModel> lossModel = CreateObject<HybridBuildingsPropagationLossModel> ();
+  Ptr<BuildingsPropagationLossModel> exactLossModel = lossModel;
+  Ptr<GridBuildingsPropagationLossModel> gridLossModel;
+  if (gridStep > 0)
+  {
+    gridLossModel = CreateObject<GridBuildingsPropagationLossModel> ();
+    lossModel = gridLossModel;
+  }
+  
+  Ptr<MultiModelSpectrumChannel> sliceChannel[3];
+  if (controlInterval <= 0)
+  {
+    std::cout << "Wrong controlInterval value!" << std::endl;
+    return 0;
+  }
+  if (asyncController && asyncPollStep <= 0)
+  {
+    std::cout << "Wrong asyncPollStep value!" << std::endl;
+    return 0;
+  }
+  if (errorModel != "nist" && errorModel != "table")
+  {
+    std::cout << "Wrong errorModel value!" << std::endl;
+    return 0;
+  }
+  TableErrorRateModel::SetPayloadSize (payloadSize);
   
   if (phyModel == "spectrum")
   {
-  	// Create the channel
-  	Ptr<MultiModelSpectrumChannel> channel = CreateObject<MultiModelSpectrumChannel> ();
-  	channel->AddPropagationLossModel (lossModel);
+  	// Create the channel, or one channel per slice sharing the same loss and delay models
   	Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
-  	channel->SetPropagationDelayModel (delayModel);
-  	spectrumPhy.SetErrorRateModel ("ns3::NistErrorRateModel");
-  	spectrumPhy.SetChannel (channel);
+  	for (int s = 0; s < (channelPerSlice ? 3 : 1); s++)
+  	{
+  	  sliceChannel[s] = CreateObject<MultiModelSpectrumChannel> ();
+  	  sliceChannel[s]->AddPropagationLossModel (lossModel);
+  	  sliceChannel[s]->SetPropagationDelayModel (delayModel);
+  	}
+  	spectrumPhy.SetErrorRateModel (errorModel == "table" ? "TableErrorRateModel" : "ns3::NistErrorRateModel");
+  	spectrumPhy.SetChannel (sliceChannel[0]);
   	//spectrumPhy.Set ("TxPowerStart", DoubleValue (txPower));
   	//spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPower));
   }
@@ -639,6 +1222,8 @@ int main (int argc, char *argv[])
     // Create the channel
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
     yansPhy.SetChannel (channel.Create ());
+    if (errorModel == "table")
+      yansPhy.SetErrorRateModel ("TableErrorRateModel");
   	//yansPhy.Set ("TxPowerStart", DoubleValue (txPower));
   	//yansPhy.Set ("TxPowerEnd", DoubleValue (txPower));
   }
@@ -737,6 +1322,8 @@ int main (int argc, char *argv[])
 
   	// Network B
   	ssid = Ssid ("networkB");
+  	if (channelPerSlice)
+  	  spectrumPhy.SetChannel (sliceChannel[1]);
   	spectrumPhy.Set ("ChannelNumber", UintegerValue (channelNumberB));
     spectrumPhy.Set ("TxPowerStart", DoubleValue (txPowerB));
     spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPowerB));
@@ -750,6 +1337,8 @@ int main (int argc, char *argv[])
 
     // Network C
     ssid = Ssid ("networkC");
+    if (channelPerSlice)
+      spectrumPhy.SetChannel (sliceChannel[2]);
     spectrumPhy.Set ("ChannelNumber", UintegerValue (channelNumberC));
     spectrumPhy.Set ("TxPowerStart", DoubleValue (txPowerC));
     spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPowerC));
@@ -808,9 +1397,12 @@ int main (int argc, char *argv[])
     return 0;
   }
 
+  build_slice_registry (staDeviceA, apDeviceA, staDeviceB, apDeviceB, staDeviceC, apDeviceC);
+
   set_channel_width();
   set_guard_interval();
   set_mcs();
+  store_applied_config();
 
   // Set RTS-CTS
   Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/RtsCtsThreshold",
@@ -831,7 +1423,7 @@ int main (int argc, char *argv[])
   positionAlloc->Add (Vector (10.0, 5.0, 2.9));
   // Set position for STAs
   for (int i = 0; i < nStaA+nStaB+nStaC; i++)
-    positionAlloc->Add (Vector (x[i], y[i], 1.5));
+    positionAlloc->Add (Vector (station.x[i], station.y[i], 1.5));
   MobilityHelper mobility;
   mobility.SetPositionAllocator (positionAlloc);
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
@@ -851,6 +1443,12 @@ int main (int argc, char *argv[])
   BuildingsHelper::Install (staNodes);
   BuildingsHelper::MakeMobilityModelConsistent ();
 
+  if (gridStep > 0)
+  {
+    gridLossModel->Build (exactLossModel, apNode.Get (0)->GetObject<MobilityModel> (), x_max, y_max, 1.5, gridStep, gridFileName);
+    std::cout << OKBLUE << "Path loss grid: max interpolation error " << gridLossModel->GetMaxError () << " dB" << ENDC << std::endl;
+  }
+  lossCache.Init (lossModel, staNodes, apNode);
   compute_channels (lossModel, staNodes, apNode);
 
   // Internet stack
@@ -859,26 +1457,32 @@ int main (int argc, char *argv[])
   stack.Install (staNodes);
 
   Ipv4AddressHelper address;
-  address.SetBase ("192.168.1.0", "255.255.255.0");
+  address.SetBase ("10.1.0.0", "255.255.0.0");
   std::vector<Ipv4InterfaceContainer> staInterfaceA(nStaA);
   for (int i = 0; i < nStaA; i++)
     staInterfaceA[i] = address.Assign (staDeviceA[i]);
   Ipv4InterfaceContainer apInterfaceA = address.Assign (apDeviceA);
 
-  address.SetBase ("192.168.2.0", "255.255.255.0");
+  address.SetBase ("10.2.0.0", "255.255.0.0");
   std::vector<Ipv4InterfaceContainer> staInterfaceB(nStaB);
   for (int i = 0; i < nStaB; i++)
     staInterfaceB[i] = address.Assign (staDeviceB[i]);
   Ipv4InterfaceContainer apInterfaceB = address.Assign (apDeviceB);
 
-  address.SetBase ("192.168.3.0", "255.255.255.0");
+  address.SetBase ("10.3.0.0", "255.255.0.0");
   std::vector<Ipv4InterfaceContainer> staInterfaceC(nStaC);
   for (int i = 0; i < nStaC; i++)
     staInterfaceC[i] = address.Assign (staDeviceC[i]);
   Ipv4InterfaceContainer apInterfaceC = address.Assign (apDeviceC);
 
   // Flow monitor
-  flowMonitor = flowHelper.InstallAll();
+  if (kpiSource == "flowMonitor")
+    flowMonitor = flowHelper.InstallAll();
+  else if (kpiSource != "trace")
+  {
+    std::cout << "Wrong kpiSource value!" << std::endl;
+    return 0;
+  }
 
   // Setting applications
   uint16_t index = 1;
@@ -924,55 +1528,33 @@ int main (int argc, char *argv[])
 
   Simulator::Stop (Seconds (simulationTime + 2));
 
-  for (int i = 2; i < simulationTime +1; i++)
-  {
-    Simulator::Schedule(Seconds(i), &update_channels,
-                        i, lossModel, staNodes, apNode);
-  }
+  if (variantFile != "")
+    Simulator::Schedule (Seconds (1.0), &warm_start);
+
+  if (1 + controlInterval <= simulationTime + 1e-9)
+    Simulator::Schedule (Seconds (1 + controlInterval), &update_channels, 2, lossModel, staNodes, apNode);
 
   time_t timeNow = time(0);
   char* ctimeNow =ctime(&timeNow);
   std::cout << OKBLUE <<"Simulation started!  Time: " << ctimeNow << ENDC;
 
   Simulator::Run ();
+  if (decision.thread.joinable ())
+    decision.Join (); // decision still pending at the end of the simulation
+  if (errorModel == "table")
+    std::cout << OKBLUE << "Error rate tables: max success rate error " << TableErrorRateModel::GetMaxError ()
+              << " (" << payloadSize << " bytes)" << ENDC << std::endl;
 
   // Activate/deactivate the histograms and the per-probe detailed stats
-  std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
-  flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
-
-  // Show results
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
-  FlowMonitor::FlowStatsContainer stats = flowMonitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
-  {
-    txPackets_unsort[i->first-1] = i->second.txPackets;
-    rxPackets_unsort[i->first-1] = i->second.rxPackets;
-    latency_unsort[i->first-1] = i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets;
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    destPorts[i->first-1] = t.destinationPort;
-    //std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << "," << destPorts[i->first-1] << ")\n";
-    //std::cout << "  Tx Packets: " << totTxPackets[i->first-1] << "\n";
-    //std::cout << "  Rx Packets: " << totRxPackets[i->first-1] << "\n";
-    //std::cout << "  Delay Sum: " << totDelay[i->first-1] << "\n";
-    //std::cout << "  Delay Sum MS: " << i->second.delaySum.ToDouble(Time::MS) << "\n";
-    //std::cout << "  Delay: " << i->second.delaySum / i->second.rxPackets << "\n";
-    //std::cout << "  Delay MS: " << i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets << "\n";
-  }
-  // Shift txPackets, rxPackets and latency
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
-  {
-  	txPackets[1][i] = txPackets[0][i];
-  	rxPackets[1][i] = rxPackets[0][i];
-  	latency[1][i] = latency[0][i];
-  }
-  // Compute txPackets, rxPackets and latency
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  if (kpiSource == "flowMonitor" && jobs == 1 && variantFile == "") // parallel runs would overwrite each other's file
   {
-    txPackets[0][destPorts[i]-5001] = txPackets_unsort[i];
-    rxPackets[0][destPorts[i]-5001] = rxPackets_unsort[i];
-    latency[0][destPorts[i]-5001] = latency_unsort[i];
+    std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
+    flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
   }
 
+  // Show results
+  read_stats();
+
   timeNow = time(0);
   ctimeNow =ctime(&timeNow);
   std::cout << OKBLUE << "Simulation finished! Time: " << ctimeNow << ENDC;
@@ -980,29 +1562,36 @@ int main (int argc, char *argv[])
 
   // Write file csvFileName.csv
   std::cout << OKBLUE <<"Writing to file: " << csvFileName << ENDC << std::endl;
-  // std::ofstream out (csvFileName.c_str ()); // Use it to overwrite the file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
+  std::ostream& out = writer.Buffer ();
   out << "fin_channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
   out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
   out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
   out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
   for (int i = 0; i < nStaA; i++)
   {
-    out << dataRateA[i] << "," << x[i] << "," << y[i] << ","
-    << txPackets[0][i] << "," << rxPackets[0][i] << "," << latency[0][i]
+    out << dataRateA[i] << "," << station.x[i] << "," << station.y[i] << ","
+    << station.TxPackets (0)[i] << "," << station.RxPackets (0)[i] << "," << station.Latency (0)[i]
     << std::endl;
   }
   for (int i = 0; i < nStaB; i++)
   {
-    out << dataRateB[i] << "," << x[nStaA+i] << "," << y[nStaA+i] << ","
-    << txPackets[0][nStaA+i] << "," << rxPackets[0][nStaA+i] << "," << latency[0][nStaA+i] << std::endl;
+    out << dataRateB[i] << "," << station.x[nStaA+i] << "," << station.y[nStaA+i] << ","
+    << station.TxPackets (0)[nStaA+i] << "," << station.RxPackets (0)[nStaA+i] << "," << station.Latency (0)[nStaA+i] << std::endl;
   }
   for (int i = 0; i < nStaC; i++)
   {
-    out << dataRateC[i] << "," << x[nStaA+nStaB+i] << "," << y[nStaA+nStaB+i] << ","
-    << txPackets[0][nStaA+nStaB+i] << "," << rxPackets[0][nStaA+nStaB+i] << "," << latency[0][nStaA+nStaB+i] << std::endl;
+    out << dataRateC[i] << "," << station.x[nStaA+nStaB+i] << "," << station.y[nStaA+nStaB+i] << ","
+    << station.TxPackets (0)[nStaA+nStaB+i] << "," << station.RxPackets (0)[nStaA+nStaB+i] << "," << station.Latency (0)[nStaA+nStaB+i] << std::endl;
   }
-  out.close ();
+  writer.Close ();
+  if (binWriter.IsOpen ())
+  {
+    write_bin_chunk (BIN_FINAL, (int) std::round (1 + (simulationTime + 1) / controlInterval), simulationTime + 2);
+    binWriter.Close ();
+  }
+  write_journal();
+  delete sliceController; // the controller releases its resources (e.g. the shared memory of shm_controller)
+  sliceController = 0;
 
   return 0;
 }
\ No newline at end of file
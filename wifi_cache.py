@@ -0,0 +1,212 @@
+#####################################
+# Author: Matteo Nerini             #
+# Email:  m.nerini20@imperial.ac.uk #
+# Date:   June 2020                 #
+#####################################
+
+# Result cache of the ns3 scripts, shared by the runners and by the sweep
+# Each seed of a run is stored under a key hashing the program identity (script name, content of
+# its .cc file and of the local headers it includes, which hold every compiled-in constant and default,
+# and the ns-3 version) with every argument except the output file names and the batch options.
+# The content of every file named by an argument (file_args: controller library, variants, candidates,
+# path loss grid) is hashed with the arguments.
+# Runs with variants (variantFile) are not cached: their outputs, one set per variant, are written as they are.
+# Seeds whose key is already in the cache are not simulated again: their stored output is appended
+# to the .csv file (and to the journal) as if they had just been run.
+# simulate_pool runs the seeds of several scenarios as (scenario, seed range) jobs on a single pool of processes.
+
+# Import
+import subprocess
+import multiprocessing
+import hashlib
+import shutil
+import json
+import os
+import re
+
+cache_dir_py = "./cache"
+cache_dir_ns3 = "./scratch/cache"
+journal_header_lines = 1
+
+# Arguments that do not change the results of a seed
+output_args = ["seed", "lastSeed", "jobs", "keepShards", "csvFileName", "journalFileName", "binFileName", "runId"]
+
+# Arguments naming a file read by the ns3 script, whose content is hashed with the arguments
+file_args = ["controller", "variantFile", "screenFileName", "gridFileName"]
+
+
+# Function to hash the identity of the ns3 script
+def get_program_hash(ns3_script):
+    h = hashlib.sha1(ns3_script.encode())
+    with open(ns3_script + ".cc", 'rb') as file:
+        source = file.read()
+    h.update(source)
+    for header in sorted(set(re.findall(r'#include\s+"([^"]+)"', source.decode('latin-1')))):
+        if os.path.exists(header):
+            with open(header, 'rb') as file:
+                h.update(header.encode())
+                h.update(file.read())
+    if os.path.exists("../VERSION"):
+        with open("../VERSION", 'rb') as file:
+            h.update(file.read())
+    return h.hexdigest()
+
+
+# Function to get the cache key of one seed
+def get_key(program_hash, arg, seed):
+    config = dict((str(name), str(arg[name])) for name in arg if name not in output_args)
+    for name in file_args:
+        if not arg.get(name):
+            continue
+        # The path is seen from the ns-3 folder
+        path = str(arg[name])
+        path = path if os.path.isabs(path) else "../" + path
+        if os.path.exists(path):
+            with open(path, 'rb') as file:
+                config[name] += "#" + hashlib.sha1(file.read()).hexdigest()
+    config["seed"] = str(seed)
+    return hashlib.sha1((program_hash + json.dumps(config, sort_keys=True)).encode()).hexdigest()
+
+
+# Function to check whether the seeds of a batch go through the cache
+# The binary output and the outputs of the variants are not cached
+def is_cached(arg):
+    return "binFileName" not in arg and not arg.get("variantFile")
+
+
+# Function to get the stored .csv output of one seed (None if the seed is not in the cache)
+def get_seed_file(ns3_script, arg, seed):
+    stored = cache_dir_py + "/" + get_key(get_program_hash(ns3_script), arg, seed) + ".csv"
+    return stored if os.path.exists(stored) else None
+
+
+def get_journal_name(csv_file):
+    return (csv_file[:-4] if csv_file.endswith(".csv") else csv_file) + "_journal.csv"
+
+
+# Function to append a stored file to the output, without its header when the output already has one
+def append(stored, target, header_lines):
+    if not os.path.exists(stored):
+        return
+    skip = header_lines if os.path.exists(target) else 0
+    with open(stored) as src, open(target, 'a') as dst:
+        for n, line in enumerate(src):
+            if n >= skip:
+                dst.write(line)
+
+
+def get_arguments(arg):
+    arguments = ""
+    for name in sorted(arg.keys()):
+        arguments += " --" + name + "=" + str(arg[name])
+    return arguments
+
+
+# Function to run the seeds arg["seed"], ..., arg["lastSeed"] of the ns3 script through the cache
+# csv_file_py is the .csv file of arg["csvFileName"] seen from this folder, the journal is written next to it
+# Returns the exit status of the simulations (0 if every seed was cached)
+def simulate(ns3_script, arg, csv_file_py, waf_run="--run", stdout=None):
+    if not is_cached(arg):
+        return subprocess.call('(cd ..; ./waf ' + waf_run + ' "' + ns3_script + get_arguments(arg) + '")',
+                               shell=True, stdout=stdout)
+    if not os.path.exists(cache_dir_py):
+        os.makedirs(cache_dir_py)
+    program_hash = get_program_hash(ns3_script)
+    first = int(arg["seed"])
+    last = max(int(arg.get("lastSeed", 0)), first)
+    keys = dict((seed, get_key(program_hash, arg, seed)) for seed in range(first, last + 1))
+    missing = [seed for seed in range(first, last + 1) if not os.path.exists(cache_dir_py + "/" + keys[seed] + ".csv")]
+    print "Cache:", last - first + 1 - len(missing), "of", last - first + 1, "seed(s) of '" + ns3_script + ".cc' found"
+
+    # Simulate the missing seeds, one batch per group of consecutive seeds
+    status = 0
+    tmp = "tmp_" + str(os.getpid()) + ".csv"
+    while missing:
+        group = [missing[0]]
+        while len(group) < len(missing) and missing[len(group)] == group[-1] + 1:
+            group.append(missing[len(group)])
+        missing = missing[len(group):]
+        run_arg = dict(arg)
+        run_arg["seed"] = group[0]
+        run_arg["lastSeed"] = group[-1]
+        run_arg["keepShards"] = 1
+        run_arg["csvFileName"] = cache_dir_ns3 + "/" + tmp
+        run_arg.pop("journalFileName", None)
+        group_status = subprocess.call('(cd ..; ./waf ' + waf_run + ' "' + ns3_script + get_arguments(run_arg) + '")',
+                                       shell=True, stdout=stdout)
+        status = max(status, group_status)
+        for seed in group:
+            shard = cache_dir_py + "/" + tmp + ".seed" + str(seed)
+            journal_shard = cache_dir_py + "/" + get_journal_name(tmp) + ".seed" + str(seed)
+            if group_status != 0:
+                # The output of a failed batch is not trusted
+                for partial in [shard, journal_shard]:
+                    if os.path.exists(partial):
+                        os.remove(partial)
+                continue
+            if os.path.exists(journal_shard):
+                shutil.move(journal_shard, cache_dir_py + "/" + keys[seed] + "_journal.csv")
+            if os.path.exists(shard):
+                shutil.move(shard, cache_dir_py + "/" + keys[seed] + ".csv") # stored last: marks the seed as complete
+
+    # Write the output of every seed in seed order
+    journal_file_py = get_journal_name(csv_file_py)
+    for seed in range(first, last + 1):
+        append(cache_dir_py + "/" + keys[seed] + ".csv", csv_file_py, 0)
+        append(cache_dir_py + "/" + keys[seed] + "_journal.csv", journal_file_py, journal_header_lines)
+    return status
+
+
+# Function to run one job of simulate_pool: (ns3_script, arg, part file)
+def simulate_job(job):
+    ns3_script, arg, part = job
+    print "Calling the ns3 script '" + ns3_script + ".cc' for seeds", arg["seed"], "to", arg["lastSeed"]
+    return simulate(ns3_script, arg, part, "--run-no-build")
+
+
+# Function to run the seeds of every scenario of arg_list through the cache on num_workers processes
+# The seeds of each scenario are split into ranges, so that there are at least num_workers jobs when possible,
+# and each job writes to its own part file; once every job has finished, the scenarios are written in the
+# order of arg_list: the parts of a cached scenario are appended to csv_file_py (and to its journal) in seed order,
+# while a batch which is not cached (binFileName, variantFile) writes its own output files, so it runs then,
+# after the scenarios before it have been written.
+# Returns the exit status of the simulations (0 if every job succeeded)
+def simulate_pool(ns3_script, arg_list, csv_file_py, num_workers):
+    if subprocess.call('(cd ..; ./waf build)', shell=True) != 0:
+        print "Build failed!"
+        return 1
+    num_seeds = sum(max(int(arg.get("lastSeed", 0)), int(arg["seed"])) - int(arg["seed"]) + 1 for arg in arg_list)
+    seeds_per_job = max(1, -(-num_seeds // max(num_workers, 1)))
+    jobs = []
+    scenarios = [] # (arg, part files of its jobs), None instead of the parts for a batch which is not cached
+    for arg in arg_list:
+        if not is_cached(arg):
+            scenarios.append((arg, None))
+            continue
+        first = int(arg["seed"])
+        last = max(int(arg.get("lastSeed", 0)), first)
+        parts = []
+        for seed in range(first, last + 1, seeds_per_job):
+            job_arg = dict(arg)
+            job_arg["seed"] = seed
+            job_arg["lastSeed"] = min(seed + seeds_per_job - 1, last)
+            job_arg["jobs"] = 1
+            parts.append(csv_file_py[:-4] + "_part" + str(len(jobs)) + ".csv")
+            jobs.append((ns3_script, job_arg, parts[-1]))
+        scenarios.append((arg, parts))
+    pool = multiprocessing.Pool(max(num_workers, 1))
+    statuses = pool.map(simulate_job, jobs, 1)
+    pool.close()
+    pool.join()
+    status = max([0] + statuses)
+    for arg, parts in scenarios:
+        if parts is None:
+            status = max(status, simulate(ns3_script, arg, csv_file_py, "--run-no-build"))
+            continue
+        for part in parts:
+            for stored, target, header_lines in [(part, csv_file_py, 0),
+                                                 (get_journal_name(part), get_journal_name(csv_file_py), journal_header_lines)]:
+                append(stored, target, header_lines)
+                if os.path.exists(stored):
+                    os.remove(stored)
+    return status
@@ -0,0 +1,606 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * State and outputs shared by the slicing scripts (wifi and wifi_dynamic):
+ *
+ *   KpiTimestampTag, KpiCollector   KPIs of each STA from the application traces (kpiSource=trace)
+ *   StationStore                    per-STA columns, with a ring of the last control windows
+ *   ResultWriter                    buffered, optionally asynchronous, writer of the .csv file
+ *   BinWriter                       columnar binary output (binFileName)
+ *   LossCache                       path loss from each STA to the AP, cached while the STA does not move
+ *   AsyncDecision                   controller run on a worker thread (asyncController)
+ *
+ * The script owns the instances and the options; each script is a single translation unit,
+ * so everything is defined here, as in wifi_models.h.
+ *
+ */
+
+#ifndef WIFI_COMMON_H
+#define WIFI_COMMON_H
+
+#include "ns3/tag.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+#include "ns3/mobility-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "slice_controller.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+// Tag carrying the time at which the OnOff client sent a packet and its sequence number in the flow,
+// read by the KPI collector and by the SLA monitor at the AP
+class KpiTimestampTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  Time txTime;
+  uint32_t seq;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (KpiTimestampTag);
+
+TypeId KpiTimestampTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("KpiTimestampTag")
+    .SetParent<Tag> ()
+    .AddConstructor<KpiTimestampTag> ();
+  return tid;
+}
+
+TypeId KpiTimestampTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t KpiTimestampTag::GetSerializedSize (void) const
+{
+  return 12;
+}
+
+void KpiTimestampTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (txTime.GetTimeStep ());
+  i.WriteU32 (seq);
+}
+
+void KpiTimestampTag::Deserialize (TagBuffer i)
+{
+  txTime = TimeStep (i.ReadU64 ());
+  seq = i.ReadU32 ();
+}
+
+void KpiTimestampTag::Print (std::ostream &os) const
+{
+  os << "txTime=" << txTime << " seq=" << seq;
+}
+
+
+// KPI collector: cumulative counters per station, updated by the OnOff Tx and UdpServer Rx traces
+struct KpiCollector
+{
+  std::vector<uint32_t> txPackets;
+  std::vector<uint32_t> rxPackets;
+  std::vector<double> delaySum; // [ms]
+
+  void Resize (int n)
+  {
+    txPackets.assign (n, 0);
+    rxPackets.assign (n, 0);
+    delaySum.assign (n, 0);
+  }
+  void Reset () { Resize (txPackets.size ()); }
+
+  // function to tag a packet sent by station sta with its tx time and sequence number, and to count it
+  void Tx (int sta, Ptr<const Packet> packet)
+  {
+    KpiTimestampTag tag;
+    tag.txTime = Simulator::Now ();
+    tag.seq = txPackets[sta];
+    packet->AddPacketTag (tag);
+    txPackets[sta]++;
+  }
+
+  // function to count a packet of station sta received at the AP
+  // Returns 0 if the packet has no tag, 1 otherwise with its tag and its delay [ms]
+  bool Rx (int sta, Ptr<const Packet> packet, KpiTimestampTag& tag, double& delay)
+  {
+    if (!packet->PeekPacketTag (tag))
+      return 0;
+    delay = (Simulator::Now () - tag.txTime).ToDouble (Time::MS);
+    rxPackets[sta]++;
+    delaySum[sta] += delay;
+    return 1;
+  }
+};
+
+
+// Station state store: one column per KPI, stations A first, then B, then C. The windowed columns keep the
+// last historyLength control windows in a ring of rows, row Row (0) being the most recent window.
+struct StationStore
+{
+  int nSta;                        // number of stations
+  int historyLength;               // number of control windows kept
+  int head;                        // ring slot of the most recent window
+  std::vector<double> x;           // initial position [m]
+  std::vector<double> y;
+  std::vector<double> rxPower;     // rx power at the AP [dBm]
+  std::vector<uint32_t> txPackets; // # txPackets until the end of each window
+  std::vector<uint32_t> rxPackets; // # rxPackets until the end of each window
+  std::vector<double> latency;     // average latency until the end of each window [ms]
+  std::vector<double> probErr;     // Pe on each window
+
+  void Resize (int n, int k)
+  {
+    nSta = n;
+    historyLength = k;
+    head = 0;
+    x.assign (n, 0);
+    y.assign (n, 0);
+    rxPower.assign (n, 0);
+    txPackets.assign (k * n, 0);
+    rxPackets.assign (k * n, 0);
+    latency.assign (k * n, 0);
+    probErr.assign (k * n, 0);
+  }
+  // the oldest window becomes the most recent one, its row is overwritten by the next read
+  void Advance () { head = (head + 1) % historyLength; }
+  // offset of the row of the window age windows before the most recent one
+  int Row (int age) const { return ((head - age) % historyLength + historyLength) % historyLength * nSta; }
+  uint32_t* TxPackets (int age) { return &txPackets[Row (age)]; }
+  uint32_t* RxPackets (int age) { return &rxPackets[Row (age)]; }
+  double* Latency (int age) { return &latency[Row (age)]; }
+  double* ProbErr (int age) { return &probErr[Row (age)]; }
+
+  // function to read the flow statistics into the most recent window. The destination port of a flow is
+  // firstPort plus its station, and the flow is classified into flowStation only the first time it is seen
+  void ReadFlowStats (Ptr<FlowMonitor> flowMonitor, FlowMonitorHelper& flowHelper, std::vector<int>& flowStation,
+                      uint16_t firstPort)
+  {
+    uint32_t* tx = TxPackets (0);
+    uint32_t* rx = RxPackets (0);
+    double* delay = Latency (0);
+    // The rows are reused without clearing: a station missing from the stats has never had a flow,
+    // so its entries are still zero
+    //flowMonitor->CheckForLostPackets ();
+    const FlowMonitor::FlowStatsContainer& stats = flowMonitor->GetFlowStats ();
+    for (FlowMonitor::FlowStatsContainerCI i = stats.begin (); i != stats.end (); ++i)
+    {
+      if (i->first >= flowStation.size ())
+        flowStation.resize (i->first + 1, -1);
+      if (flowStation[i->first] < 0)
+      {
+        Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+        flowStation[i->first] = classifier->FindFlow (i->first).destinationPort - firstPort;
+      }
+      int sta = flowStation[i->first];
+      tx[sta] = i->second.txPackets;
+      rx[sta] = i->second.rxPackets;
+      delay[sta] = i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets;
+    }
+  }
+
+  // function to snapshot the counters of a KPI collector into the most recent window
+  void ReadCollector (const KpiCollector& kpi)
+  {
+    uint32_t* tx = TxPackets (0);
+    uint32_t* rx = RxPackets (0);
+    double* delay = Latency (0);
+    for (int i = 0; i < nSta; i++)
+    {
+      tx[i] = kpi.txPackets[i];
+      rx[i] = kpi.rxPackets[i];
+      delay[i] = kpi.delaySum[i] / kpi.rxPackets[i];
+    }
+  }
+
+  // function to compute the Pe of each station on the most recent window, from the counters of the last two
+  void ComputeProbErr ()
+  {
+    uint32_t* tx = TxPackets (0);
+    uint32_t* rx = RxPackets (0);
+    uint32_t* txOld = TxPackets (1);
+    uint32_t* rxOld = RxPackets (1);
+    double* pe = ProbErr (0);
+    for (int i = 0; i < nSta; i++)
+    {
+      // probErr[i] = (txPackets[i] - rxPackets[i]) / (double)txPackets[i];
+      // A short window may have no tx packet for a low-rate STA, its Pe is then 0
+      uint32_t txWindow = tx[i] - txOld[i];
+      pe[i] = txWindow > 0 ? (txWindow - (rx[i]-rxOld[i])) / (double) txWindow : 0;
+    }
+  }
+};
+
+
+// Result writer: the .csv file is opened once per run and the rows are buffered in memory and appended
+// to the file in blocks of blockSize bytes, by a background thread if the writer is asynchronous
+class ResultWriter
+{
+public:
+  ResultWriter () : m_async (false), m_stop (false) {}
+  ~ResultWriter ()
+  {
+    if (m_file.is_open ())
+      Close ();
+  }
+
+  void Open (std::string fileName, bool async)
+  {
+    m_file.open (fileName.c_str (), std::ios::app | std::ios::binary);
+    m_async = async;
+    m_stop = false;
+    if (m_async)
+      m_thread = std::thread (&ResultWriter::Run, this);
+  }
+
+  // stream the rows are written to
+  std::ostringstream& Buffer () { return m_buffer; }
+
+  // function to hand the buffered rows to the file, only once a block is complete unless force is set
+  // (the rows stay in the buffer until the file is opened)
+  void Commit (bool force = false)
+  {
+    if (!m_file.is_open () || (!force && m_buffer.tellp () < blockSize))
+      return;
+    std::string block = m_buffer.str ();
+    m_buffer.str ("");
+    if (block.empty ())
+      return;
+    if (m_async)
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_blocks.push_back (block);
+      m_condition.notify_one ();
+    }
+    else
+      m_file.write (block.data (), block.size ());
+  }
+
+  bool IsOpen () const { return m_file.is_open (); }
+
+  void Close ()
+  {
+    Commit (true);
+    if (m_async)
+    {
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_stop = true;
+      }
+      m_condition.notify_one ();
+      m_thread.join ();
+    }
+    m_file.close ();
+  }
+
+  static const std::streamoff blockSize = 1 << 20;
+
+private:
+  // background thread: writes the committed blocks in order until the writer is closed
+  void Run ()
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    while (true)
+    {
+      m_condition.wait (lock, [this] { return m_stop || !m_blocks.empty (); });
+      while (!m_blocks.empty ())
+      {
+        std::string block;
+        block.swap (m_blocks.front ());
+        m_blocks.pop_front ();
+        lock.unlock ();
+        m_file.write (block.data (), block.size ());
+        lock.lock ();
+      }
+      if (m_stop)
+        break;
+    }
+  }
+
+  std::ofstream m_file;
+  std::ostringstream m_buffer;
+  bool m_async;
+  bool m_stop;
+  std::deque<std::string> m_blocks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::thread m_thread;
+};
+
+
+// Columnar binary output: a file header with the schema, then one chunk per record (init, update or final).
+// A chunk holds the scalar fields of the schema followed by every station column, each one contiguous,
+// stations A first, then B, then C, so that a reader can map the file and slice a column without parsing.
+//
+//   file header: "WSKB", uint32 version, uint32 # scalars, uint32 # columns,
+//                then per field: char name[16], char type ('i' int32, 'I' uint32, 'd' double), char[3] padding
+//   chunk:       "CHNK", uint32 # bytes after this field, scalars, columns (nSta values each)
+const char* binScalars[][2] = {
+  {"runId", "I"}, {"seed", "i"}, {"kind", "i"}, {"tick", "i"}, {"time", "d"},
+  {"nStaA", "i"}, {"nStaB", "i"}, {"nStaC", "i"},
+  {"channelNumberA", "i"}, {"channelWidthA", "i"}, {"giA", "i"}, {"mcsA", "i"}, {"txPowerA", "i"},
+  {"channelNumberB", "i"}, {"channelWidthB", "i"}, {"giB", "i"}, {"mcsB", "i"}, {"txPowerB", "i"},
+  {"channelNumberC", "i"}, {"channelWidthC", "i"}, {"giC", "i"}, {"mcsC", "i"}, {"txPowerC", "i"}
+};
+const char* binColumns[][2] = {
+  {"dataRate", "i"}, {"x", "d"}, {"y", "d"}, {"txPackets", "I"}, {"rxPackets", "I"},
+  {"latency", "d"}, {"probErr", "d"}, {"rxPower", "d"}
+};
+const int nBinScalars = sizeof (binScalars) / sizeof (binScalars[0]);
+const int nBinColumns = sizeof (binColumns) / sizeof (binColumns[0]);
+
+enum BinChunkKind
+{
+  BIN_INIT = 0,   // written by compute_channels
+  BIN_UPDATE = 1, // written by update_channels
+  BIN_FINAL = 2   // written at the end of the simulation
+};
+
+class BinWriter
+{
+public:
+  // function to open the binary file, writing its header first if the file is new
+  void Open (std::string fileName, bool async)
+  {
+    bool newFile = !std::ifstream (fileName.c_str ()).good ();
+    std::string pending = m_writer.Buffer ().str (); // chunks written before the file was opened
+    m_writer.Buffer ().str ("");
+    m_writer.Open (fileName, async);
+    if (newFile)
+      WriteHeader ();
+    m_writer.Buffer () << pending;
+  }
+
+  bool IsOpen () const { return m_writer.IsOpen (); }
+  void Close () { m_writer.Close (); }
+
+  // function to write one chunk: the scalars of the record, then the data rates of the STAs of each slice
+  // and the columns of the most recent window of the station store
+  void WriteChunk (uint32_t runId, int seed, BinChunkKind kind, int tick, double time, const int nSta[3],
+                   const SliceConfig config[3], const std::vector<int>* const dataRate[3], StationStore& station)
+  {
+    std::ostream& out = m_writer.Buffer ();
+    int n = nSta[0] + nSta[1] + nSta[2];
+    uint32_t bytes = 4 * 22 + 8 + n * (4 + 8 + 8 + 4 + 4 + 8 + 8 + 8);
+    int32_t counters[3] = {seed, kind, tick};
+    int32_t sizes[3] = {nSta[0], nSta[1], nSta[2]};
+    out.write ("CHNK", 4);
+    Put (out, &bytes, 1);
+    Put (out, &runId, 1);
+    Put (out, counters, 3);
+    Put (out, &time, 1);
+    Put (out, sizes, 3);
+    Put (out, (const int32_t*) config, 15);
+    for (int s = 0; s < 3; s++)
+      Put (out, dataRate[s]->data (), nSta[s]);
+    Put (out, station.x.data (), n);
+    Put (out, station.y.data (), n);
+    Put (out, station.TxPackets (0), n);
+    Put (out, station.RxPackets (0), n);
+    Put (out, station.Latency (0), n);
+    Put (out, station.ProbErr (0), n);
+    Put (out, station.rxPower.data (), n);
+    m_writer.Commit ();
+  }
+
+  // bytes of the header of a binary file
+  static std::size_t HeaderSize () { return 16 + 20 * (std::size_t) (nBinScalars + nBinColumns); }
+
+private:
+  // function to write raw values to the binary file
+  template <typename T>
+  static void Put (std::ostream& out, const T* values, std::size_t n)
+  {
+    out.write ((const char*) values, n * sizeof (T));
+  }
+
+  // function to write the header of a new binary file
+  void WriteHeader ()
+  {
+    std::ostream& out = m_writer.Buffer ();
+    uint32_t header[3] = {1, (uint32_t) nBinScalars, (uint32_t) nBinColumns};
+    out.write ("WSKB", 4);
+    Put (out, header, 3);
+    for (int k = 0; k < nBinScalars + nBinColumns; k++)
+    {
+      const char** field = k < nBinScalars ? binScalars[k] : binColumns[k - nBinScalars];
+      char descriptor[20] = {0};
+      strncpy (descriptor, field[0], 15);
+      descriptor[16] = field[1][0];
+      out.write (descriptor, 20);
+    }
+  }
+
+  ResultWriter m_writer;
+};
+
+
+// Path loss from each STA to the AP, cached while the STA does not move
+struct LossCache
+{
+  Ptr<PropagationLossModel> lossModel;
+  Ptr<MobilityModel> ap;
+  std::vector<Ptr<MobilityModel> > sta;
+  std::vector<double> loss;
+  std::vector<bool> valid;
+
+  // function to set up the cache of the STAs of staNodes
+  void Init (Ptr<PropagationLossModel> model, NodeContainer staNodes, NodeContainer apNode)
+  {
+    int nSta = staNodes.GetN ();
+    lossModel = model;
+    ap = apNode.Get (0)->GetObject<MobilityModel> ();
+    ap->TraceConnectWithoutContext ("CourseChange", MakeBoundCallback (&LossCache::Invalidate, this, -1));
+    sta.resize (nSta);
+    loss.assign (nSta, 0);
+    valid.assign (nSta, false);
+    for (int i = 0; i < nSta; i++)
+    {
+      sta[i] = staNodes.Get (i)->GetObject<MobilityModel> ();
+      sta[i]->TraceConnectWithoutContext ("CourseChange", MakeBoundCallback (&LossCache::Invalidate, this, i));
+    }
+  }
+
+  // function to get the path loss from STA i to the AP [dB]
+  // A moving STA changes position without CourseChange, so its loss is cached only while its velocity is zero
+  double Get (int i)
+  {
+    if (!valid[i])
+    {
+      loss[i] = lossModel->GetLoss (sta[i], ap);
+      Vector velocity = sta[i]->GetVelocity ();
+      valid[i] = velocity.x == 0 && velocity.y == 0 && velocity.z == 0;
+    }
+    return loss[i];
+  }
+
+  // function called by the CourseChange trace of STA i (i = -1 for the AP)
+  static void Invalidate (LossCache* cache, int i, Ptr<const MobilityModel> model)
+  {
+    if (i < 0)
+      std::fill (cache->valid.begin (), cache->valid.end (), false);
+    else
+      cache->valid[i] = false;
+  }
+};
+
+
+// Decision of the controller computed by a worker thread (asyncController) from an owned copy of the snapshot,
+// while the simulation goes on. The worker measures its compute time, so that the script can apply the decision
+// at sample time plus compute time, and the output of the controller is buffered until the worker is joined
+struct AsyncDecision
+{
+  bool pending = 0;                // a decision has been requested and not applied yet
+  bool done = 0;                   // the worker has finished, guarded by mutex
+  int tick;                        // control tick of the snapshot
+  Time sampleTime;                 // simulation time of the snapshot
+  double computeTime;              // wall clock time of the controller [s]
+  SliceConfig config[3];
+  KpiSnapshot snapshot;            // points into the vectors below
+  std::vector<int> dataRate;
+  std::vector<double> x, y, loss, rxPower;
+  std::vector<uint32_t> txPackets, rxPackets;
+  std::vector<double> latency, probErr;
+  std::vector<const uint32_t*> txRows, rxRows;
+  std::vector<const double*> latencyRows, probErrRows;
+  std::ostringstream output;       // output of the controller
+  SliceController* controller = 0;
+  std::mutex mutex;
+  std::thread thread;
+
+  // function to start the worker on a copy of kpi, the snapshot of control tick requestTick,
+  // from the configuration current of the slices
+  void Start (SliceController* sliceController, const KpiSnapshot& kpi, const SliceConfig current[3], int requestTick)
+  {
+    CopySnapshot (kpi);
+    std::copy (current, current + 3, config);
+    controller = sliceController;
+    pending = 1;
+    done = 0;
+    tick = requestTick;
+    sampleTime = Simulator::Now ();
+    controller->log = &output;
+    thread = std::thread (&AsyncDecision::Run, this);
+  }
+
+  // function to check whether the worker has finished, without waiting for it
+  bool Ready ()
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    return done;
+  }
+
+  // function to collect the worker and print the output of the controller
+  void Join ()
+  {
+    thread.join ();
+    controller->log = &std::cout;
+    std::cout << output.str () << std::flush;
+    output.str ("");
+  }
+
+private:
+  // function to copy the snapshot, so that the worker does not read the live station store
+  void CopySnapshot (const KpiSnapshot& kpi)
+  {
+    int nSta = kpi.nSta[0] + kpi.nSta[1] + kpi.nSta[2];
+    int k = kpi.historyLength;
+    snapshot = kpi;
+    dataRate.assign (kpi.dataRate, kpi.dataRate + nSta);
+    x.assign (kpi.x, kpi.x + nSta);
+    y.assign (kpi.y, kpi.y + nSta);
+    loss.assign (kpi.loss, kpi.loss + nSta);
+    rxPower.assign (kpi.rxPower, kpi.rxPower + nSta);
+    txPackets.resize (k * nSta);
+    rxPackets.resize (k * nSta);
+    latency.resize (k * nSta);
+    probErr.resize (k * nSta);
+    txRows.resize (k);
+    rxRows.resize (k);
+    latencyRows.resize (k);
+    probErrRows.resize (k);
+    for (int w = 0; w < k; w++)
+    {
+      std::copy (kpi.txPackets[w], kpi.txPackets[w] + nSta, &txPackets[w * nSta]);
+      std::copy (kpi.rxPackets[w], kpi.rxPackets[w] + nSta, &rxPackets[w * nSta]);
+      std::copy (kpi.latency[w], kpi.latency[w] + nSta, &latency[w * nSta]);
+      std::copy (kpi.probErr[w], kpi.probErr[w] + nSta, &probErr[w * nSta]);
+      txRows[w] = &txPackets[w * nSta];
+      rxRows[w] = &rxPackets[w * nSta];
+      latencyRows[w] = &latency[w * nSta];
+      probErrRows[w] = &probErr[w * nSta];
+    }
+    snapshot.dataRate = dataRate.data ();
+    snapshot.x = x.data ();
+    snapshot.y = y.data ();
+    snapshot.loss = loss.data ();
+    snapshot.rxPower = rxPower.data ();
+    snapshot.txPackets = txRows.data ();
+    snapshot.rxPackets = rxRows.data ();
+    snapshot.latency = latencyRows.data ();
+    snapshot.probErr = probErrRows.data ();
+  }
+
+  // function run by the worker thread
+  void Run ()
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+    controller->Update (snapshot, config);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+    std::lock_guard<std::mutex> lock (mutex);
+    computeTime = elapsed.count ();
+    done = 1;
+  }
+};
+
+} // namespace ns3
+
+#endif /* WIFI_COMMON_H */
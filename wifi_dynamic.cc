@@ -55,6 +55,9 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/multi-model-spectrum-channel.h"
 #include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/constant-rate-wifi-manager.h"
+#include "ns3/he-configuration.h"
 #include "ns3/qos-txop.h"
 #include "ns3/wifi-mac.h"
 #include "ns3/rng-seed-manager.h"
@@ -62,8 +65,18 @@
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/netanim-module.h"
 #include "ns3/buildings-module.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/nist-error-rate-model.h"
 #include "ns3/ipv4-flow-classifier.h"
+#include "ns3/tag.h"
 #include <bits/stdc++.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include "slice_controller.h"
+#include "seed_pool.h"
+#include "wifi_models.h"
+#include "wifi_common.h"
 
 #define ENDC    "\033[0m"
 #define ERROR   "\033[91m"
@@ -94,24 +107,48 @@ int tab2[12] = {-69, -66, -63, -59, -56, -52, -50, -48, -44, -43, -39, -37};
 
 uint32_t payloadSize = 1472;          // bytes (UDP)
 double simulationTime = 15;           // seconds
+double controlInterval = 1;           // control period T: update_channels is called every T seconds of traffic
+bool verbose = 1;                     // 1 prints the Pe of every STA at each control tick
 int seed = 1;                         // seed used in the simulation
+int lastSeed = 0;                     // last seed of a batch (0 = only seed)
+int jobs = 1;                         // seeds of a batch run at the same time
+bool keepShards = 0;                  // 1 leaves the shard of each seed unmerged
+std::string variantFile = "";         // variants run from the start of the traffic (empty = none)
+std::string screenFileName = "";      // candidate configurations ranked by the estimator, without simulating (empty = none)
+std::string controllerLibrary = "";   // shared library of the slice controller (empty = built-in controller)
+std::string controllerArgs = "";      // arguments passed to the controller of the library
+bool pinConfig = 0;                   // 1 keeps the slice configuration of the command line, the controller is not run
+bool asyncController = 0;             // 1 runs the controller on a worker thread while the simulation goes on
+double decisionDelay = -1;            // delay between the KPI sample and the decision of the worker [s] (negative = compute time)
+double asyncPollStep = 0.001;         // simulation step between two checks of the worker [s]
 std::string csvFileName = "test.csv"; // csv file name
+std::string binFileName = "";         // binary file name (empty = no binary output)
+uint32_t runId = 0;                   // run identifier written in the binary file (0 = seed)
 std::string band = "AX_5";            // AC_5, AX_2.4 or AX_5
-std::string phyModel = "spectrum";    // "spectrum" or "yans"
+std::string phyModel = "spectrum";    // "spectrum", "yans" or "abstract" (frame-level model of each slice medium)
 bool constantMcs = 1;                 // 0 Minstrel or 1 constant
 bool enablePcap = 0;                  // 0 no Pcap or 1 Pcap
+bool channelPerSlice = 0;             // 1 one spectrum channel per slice (slice bands must not overlap)
+double gridStep = 0;                  // step of the AP path loss grid [m] (0 = exact model)
+std::string gridFileName = "";        // file the AP path loss grid is loaded from or saved to (empty = none)
+std::string errorModel = "nist";      // "nist" or "table" (Nist model served from tables)
+double abstractStep = 0.1;            // step of the abstract PHY [s]
 double x_max = 20.0;                  // meters
 double y_max = 10.0;                  // meters
 double z_max = 3.0;                   // meters
-const int nStaA = 6;                  // number of stations A
-const int nStaB = 100;                // number of stations B
-const int nStaC = 2;                  // number of stations C
+int nStaA = 6;                        // number of stations A
+int nStaB = 100;                      // number of stations B
+int nStaC = 2;                        // number of stations C
+int dataRateMinA = 80;                // data rate A drawn in [min, max) Mb/s
+int dataRateMaxA = 101;
+int dataRateMinB = 30;                // data rate B drawn in [min, max) Kb/s
+int dataRateMaxB = 51;
+int dataRateMinC = 20;                // data rate C drawn in [min, max) Mb/s
+int dataRateMaxC = 41;
 // Network A
 int channelNumberA = 42;  // Channel number A
 int channelWidthA = 20;   // 20, 40, 80 or 160 MHz
 int mcsA = 5;             // from 0 to 11 (-1 = unset value)
-int mcsA_min = 0;
-int mcsA_max = 11;
 int giA = 800;            // 800, 1600 or 3200 ns
 int txPowerA = 20;        // dBm
 std::string dataRateA_old = "10Mb/s";
@@ -126,59 +163,99 @@ std::string dataRateB_old = "10Mb/s";
 int channelNumberC = 155; // Channel number B
 int channelWidthC = 40;   // 20, 40, 80 or 160 MHz
 int mcsC = 5;             // from 0 to 11 (-1 = unset value)
-int mcsC_min = 0;
-int mcsC_max = 11;
 int giC = 800;            // 800, 1600 or 3200 ns
 int txPowerC = 20;        // dBm
 std::string dataRateC_old = "10Mb/s";
 
-std::vector<int> dataRateA(nStaA);
-std::vector<int> dataRateB(nStaB);
-std::vector<int> dataRateC(nStaC);
+std::vector<int> dataRateA;
+std::vector<int> dataRateB;
+std::vector<int> dataRateC;
 
 int dataRateSumA = 0;
 int dataRateSumB = 0;
 int dataRateSumC = 0;
 
-std::vector<uint64_t> rxPacketsA_meas(nStaA);
-std::vector<uint64_t> rxPacketsB_meas(nStaB);
-std::vector<uint64_t> rxPacketsC_meas(nStaC);
+std::vector<uint64_t> rxPacketsA_meas;
+std::vector<uint64_t> rxPacketsB_meas;
+std::vector<uint64_t> rxPacketsC_meas;
 
-std::vector<double> pathLoss(nStaA+nStaB+nStaC);
-std::vector<double> rxPower(nStaA+nStaB+nStaC);
-
-std::vector<double> x(nStaA+nStaB+nStaC);
-std::vector<double> y(nStaA+nStaB+nStaC);
+std::vector<double> pathLoss;
 
 Ptr<FlowMonitor> flowMonitor;
 FlowMonitorHelper flowHelper;
+std::vector<int> flowStation; // station of each flow, indexed by FlowId (-1 = not classified yet)
+std::string kpiSource = "flowMonitor"; // KPIs from the "flowMonitor" or from the application traces ("trace")
+
+KpiCollector kpi;      // KPIs from the application traces (kpiSource = "trace")
+StationStore station;  // per-STA KPIs of the last control windows
+int historyLength = 2; // number of control windows kept in the station store (at least 2)
+
+
+// Slice registry: direct handles to the PHY, the rate manager and the HE configuration of every device of a slice
+struct SliceDevices
+{
+  std::vector<Ptr<WifiPhy> > phy;
+  std::vector<Ptr<ConstantRateWifiManager> > manager; // null if the device does not use ConstantRateWifiManager
+  std::vector<Ptr<HeConfiguration> > heConfiguration; // null if the device is not HE
+};
+
+SliceDevices sliceDevices[3]; // slices A, B and C
 
-std::vector<uint32_t> txPackets_unsort(nStaA+nStaB+nStaC);
-std::vector<uint32_t> rxPackets_unsort(nStaA+nStaB+nStaC);
-std::vector<double> latency_unsort(nStaA+nStaB+nStaC);
-//std::vector<uint32_t> txPackets(nStaA+nStaB+nStaC);
-//std::vector<uint32_t> rxPackets(nStaA+nStaB+nStaC);
-//std::vector<double> latency(nStaA+nStaB+nStaC);
-uint32_t txPackets[2][nStaA+nStaB+nStaC]; // # txPackets until t0 and t0-T
-uint32_t rxPackets[2][nStaA+nStaB+nStaC]; // # rxPackets until t0 and t0-T
-double latency[2][nStaA+nStaB+nStaC];     // # average latency until t0 and t0-T
+SliceConfig appliedConfig[3];    // configuration currently applied to the devices of slices A, B and C
+std::ostringstream journal;      // changes applied to the slices: seed, time, slice, parameter, old value, new value
+std::string journalFileName = ""; // journal file name (empty = csvFileName with suffix _journal)
+const std::string journalHeader = "seed, time, slice, parameter, old, new";
 
-std::vector<uint32_t> destPorts(nStaA+nStaB+nStaC);
 
-//std::vector<double> prob_err(nStaA+nStaB+nStaC);
-double probErr[2][nStaA+nStaB+nStaC]; // Pe on last T=[t0-T, t0] and on previous T=[t0-2T, t0-T]
+ResultWriter writer;  // rows of the .csv file
+bool asyncWriter = 0; // 0 the rows are written by the simulation thread, 1 by a background thread
 
-bool sliceA;
-bool sliceA_improved;
-bool sliceB;
-bool sliceB_improved;
-bool sliceC;
-bool sliceC_improved;
+// SLA of the slices checked by the controller
+double probErrMaxA = 0.02; // max Pe of each STA A
+double probErrMaxB = 0.02; // max Pe of a STA B
+double offMaxB = 0.1;      // max fraction of STAs B above probErrMaxB
+double probErrMaxC = 0.01; // max Pe of each STA C
+double latencyMaxC = 5;    // max latency of each STA C [ms]
 
-int channelWidthMulA = 1;
-int mcsAddB = 1;
-int txPowerAddB = 3;
-int channelWidthMulC = 1;
+// SLA monitor
+bool slaMonitor = 0;              // 1 fires the controller on SLA violations and skips the quiet ticks (kpiSource = "trace")
+double slaMargin = 0.5;           // a slice is quiet while its KPIs are below slaMargin times their SLA bound
+int maxQuietTicks = 4;            // max consecutive periodic ticks skipped
+uint32_t monitorMinPackets = 20;  // packets of a STA in the window before its KPIs are checked
+double triggerHoldoff = 0.05;     // min time between a controller run and the next one fired by the monitor [s]
+
+// SLA monitor: streaming KPIs of each STA on the current control window, updated by every received packet.
+// A packet missing from the sequence of its flow is counted as lost when the next one arrives.
+// As soon as a slice breaks its SLA the controller is run, without waiting for the next periodic tick
+struct SlaMonitor
+{
+  std::vector<uint32_t> nextSeq; // sequence number expected from each STA
+  std::vector<uint32_t> rx;      // # rx packets in the window
+  std::vector<uint32_t> lost;    // # lost packets in the window
+  std::vector<double> delaySum;  // [ms]
+  std::vector<bool> off;         // STA B above probErrMaxB in the window
+  int offB;                      // # STAs B above probErrMaxB in the window
+  bool triggered;                // controller run already scheduled
+  int quietTicks;                // consecutive periodic ticks skipped
+
+  void Resize (int n)
+  {
+    nextSeq.assign (n, 0);
+    quietTicks = 0;
+    Reset ();
+  }
+  void Reset ()
+  {
+    rx.assign (nextSeq.size (), 0);
+    lost.assign (nextSeq.size (), 0);
+    delaySum.assign (nextSeq.size (), 0);
+    off.assign (nextSeq.size (), 0);
+    offB = 0;
+    triggered = 0;
+  }
+};
+
+SlaMonitor monitor;
 
 
 // function to define the parameters which can be set when the script is called
@@ -187,12 +264,34 @@ void configure (int argc, char *argv[])
   CommandLine cmd;
   cmd.AddValue ("payloadSize", "Payload size in bytes", payloadSize);
   cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
+  cmd.AddValue ("controlInterval", "Control period in seconds", controlInterval);
+  cmd.AddValue ("verbose", "Print the Pe of every STA at each control tick", verbose);
   cmd.AddValue ("seed", "Seed", seed);
+  cmd.AddValue ("lastSeed", "Run the seeds seed, ..., lastSeed in a batch", lastSeed);
+  cmd.AddValue ("jobs", "Number of seeds of a batch run in parallel", jobs);
+  cmd.AddValue ("keepShards", "Write one shard per seed and do not merge them", keepShards);
+  cmd.AddValue ("variantFile", "File with one variant per line (name=value ...) forked at the start of the traffic", variantFile);
+  cmd.AddValue ("controller", "Shared library of the slice controller (empty = built-in)", controllerLibrary);
+  cmd.AddValue ("controllerArgs", "Arguments of the slice controller of the library", controllerArgs);
+  cmd.AddValue ("pinConfig", "Keep the slice configuration of the command line for the whole run, without running the controller", pinConfig);
+  cmd.AddValue ("asyncController", "Run the controller on a worker thread while the simulation goes on", asyncController);
+  cmd.AddValue ("decisionDelay", "Delay of the decisions of the worker [s] (negative = measured compute time)", decisionDelay);
+  cmd.AddValue ("asyncPollStep", "Simulation step between two checks of the worker [s]", asyncPollStep);
+  cmd.AddValue ("screenFileName", "File with one candidate configuration per line (name=value ...) to rank", screenFileName);
   cmd.AddValue ("csvFileName", "Name of the .csv file", csvFileName);
   cmd.AddValue ("band", "AC_5, AX_2.4 or AX_5", band);
   cmd.AddValue ("phyModel", "PHY layer model", phyModel);
+  cmd.AddValue ("abstractStep", "Step of the abstract PHY [s]", abstractStep);
   cmd.AddValue ("constantMcs", "0 Minstrel or 1 constant", constantMcs);
   cmd.AddValue ("enablePcap", "Enable/disable pcap file generation", enablePcap);
+  cmd.AddValue ("channelPerSlice", "One spectrum channel per slice (bands must not overlap)", channelPerSlice);
+  cmd.AddValue ("gridStep", "Step of the interpolated AP path loss grid [m] (0 = exact model)", gridStep);
+  cmd.AddValue ("gridFileName", "File of the AP path loss grid", gridFileName);
+  cmd.AddValue ("errorModel", "Error rate model: nist or table", errorModel);
+  cmd.AddValue ("journalFileName", "Name of the .csv file of the applied changes", journalFileName);
+  cmd.AddValue ("asyncWriter", "Write the .csv file from a background thread", asyncWriter);
+  cmd.AddValue ("binFileName", "Name of the columnar binary file (empty = none)", binFileName);
+  cmd.AddValue ("runId", "Run identifier written in the binary file (0 = seed)", runId);
   // Network A
   cmd.AddValue ("channelNumberA", "Channel number A", channelNumberA);
   cmd.AddValue ("channelWidthA", "Channel width A", channelWidthA);
@@ -215,169 +314,448 @@ void configure (int argc, char *argv[])
   cmd.AddValue ("txPowerC", "Transmission power C", txPowerC);
   cmd.AddValue ("dataRateC_old", "Data rate C", dataRateC_old);
 
-  //cmd.AddValue ("nStaA", "Number Stations A", nStaA);
-  //cmd.AddValue ("nStaB", "Number Stations B", nStaB);
-  //cmd.AddValue ("nStaC", "Number Stations C", nStaC);
+  cmd.AddValue ("nStaA", "Number Stations A", nStaA);
+  cmd.AddValue ("nStaB", "Number Stations B", nStaB);
+  cmd.AddValue ("nStaC", "Number Stations C", nStaC);
+  cmd.AddValue ("dataRateMinA", "Minimum data rate A [Mb/s]", dataRateMinA);
+  cmd.AddValue ("dataRateMaxA", "Maximum data rate A (excluded) [Mb/s]", dataRateMaxA);
+  cmd.AddValue ("dataRateMinB", "Minimum data rate B [Kb/s]", dataRateMinB);
+  cmd.AddValue ("dataRateMaxB", "Maximum data rate B (excluded) [Kb/s]", dataRateMaxB);
+  cmd.AddValue ("dataRateMinC", "Minimum data rate C [Mb/s]", dataRateMinC);
+  cmd.AddValue ("dataRateMaxC", "Maximum data rate C (excluded) [Mb/s]", dataRateMaxC);
+  cmd.AddValue ("historyLength", "Number of control windows kept in the station store", historyLength);
+  cmd.AddValue ("kpiSource", "flowMonitor or trace", kpiSource);
+  cmd.AddValue ("probErrMaxA", "SLA A: max Pe of each STA", probErrMaxA);
+  cmd.AddValue ("probErrMaxB", "SLA B: max Pe of a STA", probErrMaxB);
+  cmd.AddValue ("offMaxB", "SLA B: max fraction of STAs above probErrMaxB", offMaxB);
+  cmd.AddValue ("probErrMaxC", "SLA C: max Pe of each STA", probErrMaxC);
+  cmd.AddValue ("latencyMaxC", "SLA C: max latency of each STA [ms]", latencyMaxC);
+  cmd.AddValue ("slaMonitor", "Fire the controller on SLA violations and skip the quiet ticks (sets kpiSource=trace)", slaMonitor);
+  cmd.AddValue ("slaMargin", "Fraction of the SLA bounds below which a slice is quiet", slaMargin);
+  cmd.AddValue ("maxQuietTicks", "Max consecutive control ticks skipped by the SLA monitor", maxQuietTicks);
+  cmd.AddValue ("monitorMinPackets", "Packets of a STA in the window before the SLA monitor checks it", monitorMinPackets);
+  cmd.AddValue ("triggerHoldoff", "Min time between a controller run and the next one fired by the SLA monitor [s]", triggerHoldoff);
   cmd.Parse (argc, argv);
+  // Every slice needs at least one STA (the controllers size the slices from their STAs)
+  if (nStaA <= 0 || nStaB <= 0 || nStaC <= 0)
+  {
+    std::cout << ERROR << "nStaA, nStaB and nStaC must be positive (" << nStaA << ", " << nStaB << ", " << nStaC << ")!"
+              << ENDC << std::endl;
+    std::exit (1);
+  }
 }
 
 
-// function to set the channel number
-void set_channel_number()
+// function to size the per-station state according to the number of stations
+void allocate_stations()
 {
-  for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberA)); ///NodeList/3/DeviceList 3?
-  for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberB));
-  for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelNumber",
-                 UintegerValue (channelNumberC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/ChannelNumber",
-               UintegerValue (channelNumberC));
+  int nSta = nStaA + nStaB + nStaC;
+  dataRateA.assign (nStaA, 0);
+  dataRateB.assign (nStaB, 0);
+  dataRateC.assign (nStaC, 0);
+  rxPacketsA_meas.assign (nStaA, 0);
+  rxPacketsB_meas.assign (nStaB, 0);
+  rxPacketsC_meas.assign (nStaC, 0);
+  pathLoss.assign (nSta, 0);
+  station.Resize (nSta, std::max (historyLength, 2));
+  kpi.Resize (nSta);
+  monitor.Resize (nSta);
 }
 
 
-// function to set the channel width
-void set_channel_width()
+// function to store the handles of one device in the registry of its slice
+void add_slice_device (SliceDevices& slice, Ptr<NetDevice> device)
+{
+  Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice> (device);
+  slice.phy.push_back (wifiDevice->GetPhy ());
+  slice.manager.push_back (DynamicCast<ConstantRateWifiManager> (wifiDevice->GetRemoteStationManager ()));
+  slice.heConfiguration.push_back (wifiDevice->GetHeConfiguration ());
+}
+
+
+// function to build the slice registry, STA devices first and then the AP device of each slice
+void build_slice_registry (std::vector<NetDeviceContainer>& staDeviceA, NetDeviceContainer& apDeviceA,
+                           std::vector<NetDeviceContainer>& staDeviceB, NetDeviceContainer& apDeviceB,
+                           std::vector<NetDeviceContainer>& staDeviceC, NetDeviceContainer& apDeviceC)
 {
   for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthA));
+    add_slice_device (sliceDevices[0], staDeviceA[i].Get (0));
+  add_slice_device (sliceDevices[0], apDeviceA.Get (0));
   for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthB));
+    add_slice_device (sliceDevices[1], staDeviceB[i].Get (0));
+  add_slice_device (sliceDevices[1], apDeviceB.Get (0));
   for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/ChannelWidth",
-                 UintegerValue (channelWidthC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/ChannelWidth",
-               UintegerValue (channelWidthC));
+    add_slice_device (sliceDevices[2], staDeviceC[i].Get (0));
+  add_slice_device (sliceDevices[2], apDeviceC.Get (0));
 }
 
 
-// function to set the tx power
-void set_tx_power()
+// function to set the channel number of the devices of one slice
+void set_slice_channel_number (SliceDevices& slice, int channelNumber)
 {
-  for (int i = 0; i < nStaA; i++)
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
+    slice.phy[i]->SetChannelNumber (channelNumber);
+}
+
+
+// function to set the channel number
+void set_channel_number()
+{
+  set_slice_channel_number (sliceDevices[0], channelNumberA);
+  set_slice_channel_number (sliceDevices[1], channelNumberB);
+  set_slice_channel_number (sliceDevices[2], channelNumberC);
+}
+
+
+// function to get the width [MHz] a PHY switches to when it is set to channelNumber,
+// according to the channel table of WifiPhy (SetChannelNumber also resets the channel width)
+int default_channel_width (int channelNumber)
+{
+  switch (channelNumber)
   {
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerA));
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerA));
+    case 50: case 114:
+      return 160;
+    case 42: case 58: case 106: case 122: case 138: case 155:
+      return 80;
+    case 38: case 46: case 54: case 62: case 102: case 110: case 118: case 126: case 134: case 142: case 151: case 159:
+      return 40;
+    default:
+      return 20;
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerA));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerA));
-  for (int i = 0; i < nStaB; i++)
+}
+
+
+// function to set the channel width of the devices of one slice
+void set_slice_channel_width (SliceDevices& slice, int channelWidth)
+{
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
+    slice.phy[i]->SetChannelWidth (channelWidth);
+}
+
+
+// function to set the channel width
+void set_channel_width()
+{
+  set_slice_channel_width (sliceDevices[0], channelWidthA);
+  set_slice_channel_width (sliceDevices[1], channelWidthB);
+  set_slice_channel_width (sliceDevices[2], channelWidthC);
+}
+
+
+// function to set the tx power of the devices of one slice
+void set_slice_tx_power (SliceDevices& slice, int txPower)
+{
+  for (std::size_t i = 0; i < slice.phy.size (); i++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerB));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerB));
+    slice.phy[i]->SetTxPowerStart (txPower);
+    slice.phy[i]->SetTxPowerEnd (txPower);
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerB));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerB));
-  for (int i = 0; i < nStaC; i++)
+}
+
+
+// function to set the tx power
+void set_tx_power()
+{
+  set_slice_tx_power (sliceDevices[0], txPowerA);
+  set_slice_tx_power (sliceDevices[1], txPowerB);
+  set_slice_tx_power (sliceDevices[2], txPowerC);
+}
+
+
+// function to set the guard interval of the devices of one slice
+void set_slice_guard_interval (SliceDevices& slice, int gi)
+{
+  for (std::size_t i = 0; i < slice.heConfiguration.size (); i++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerStart",
-                 DoubleValue (txPowerC));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-                 DoubleValue (txPowerC));
+    if (slice.heConfiguration[i] != 0)
+      slice.heConfiguration[i]->SetGuardInterval (NanoSeconds (gi));
   }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/TxPowerStart",
-               DoubleValue (txPowerC));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/Phy/TxPowerEnd",
-               DoubleValue (txPowerC));
 }
 
 
 // function to set the guard interval
 void set_guard_interval()
 {
-  for (int i = 0; i < nStaA; i++)
-    Config::Set ("/NodeList/" + std::to_string(i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giA)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giA)));
-  for (int i = 0; i < nStaB; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giB)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/1/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giB)));
-  for (int i = 0; i < nStaC; i++)
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) + "/DeviceList/0/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-                 TimeValue (NanoSeconds (giC)));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) + "/DeviceList/2/$ns3::WifiNetDevice/HeConfiguration/GuardInterval",
-               TimeValue (NanoSeconds (giC)));
+  set_slice_guard_interval (sliceDevices[0], giA);
+  set_slice_guard_interval (sliceDevices[1], giB);
+  set_slice_guard_interval (sliceDevices[2], giC);
+}
+
+
+// function to set the modulation and coding scheme of the devices of one slice
+void set_slice_mcs (SliceDevices& slice, int mcs)
+{
+  std::ostringstream oss;
+  oss << "HeMcs" << mcs;
+  WifiModeValue mode (WifiMode (oss.str ()));
+  for (std::size_t i = 0; i < slice.manager.size (); i++)
+  {
+    if (slice.manager[i] != 0)
+    {
+      slice.manager[i]->SetAttribute ("DataMode", mode);
+      slice.manager[i]->SetAttribute ("ControlMode", mode);
+    }
+  }
 }
 
 
 // function to set the modulation and coding scheme
 void set_mcs()
 {
-  std::ostringstream ossA;
-  ossA << "HeMcs" << mcsA;
-  for (int i = 0; i < nStaA; i++)
+  set_slice_mcs (sliceDevices[0], mcsA);
+  set_slice_mcs (sliceDevices[1], mcsB);
+  set_slice_mcs (sliceDevices[2], mcsC);
+}
+
+
+// function to collect the configuration computed for each slice
+void get_config (SliceConfig config[3])
+{
+  SliceConfig computed[3] = {
+    {channelNumberA, channelWidthA, giA, mcsA, txPowerA},
+    {channelNumberB, channelWidthB, giB, mcsB, txPowerB},
+    {channelNumberC, channelWidthC, giC, mcsC, txPowerC}
+  };
+  for (int s = 0; s < 3; s++)
+    config[s] = computed[s];
+}
+
+
+// function to set the configuration of each slice
+void set_config (const SliceConfig config[3])
+{
+  channelNumberA = config[0].channelNumber;
+  channelWidthA = config[0].channelWidth;
+  giA = config[0].gi;
+  mcsA = config[0].mcs;
+  txPowerA = config[0].txPower;
+  channelNumberB = config[1].channelNumber;
+  channelWidthB = config[1].channelWidth;
+  giB = config[1].gi;
+  mcsB = config[1].mcs;
+  txPowerB = config[1].txPower;
+  channelNumberC = config[2].channelNumber;
+  channelWidthC = config[2].channelWidth;
+  giC = config[2].gi;
+  mcsC = config[2].mcs;
+  txPowerC = config[2].txPower;
+}
+
+
+// function to warn when the bands of two slices overlap while each slice has its own channel,
+// since their frames would then not interfere as they do on a single channel
+void check_slice_bands()
+{
+  if (!channelPerSlice || phyModel != "spectrum")
+    return;
+  for (int s = 0; s < 3; s++)
   {
-    Config::Set ("/NodeList/" + std::to_string(i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossA.str ()));
-    Config::Set ("/NodeList/" + std::to_string(i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossA.str ()));
-  }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossA.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossA.str ()));
-  std::ostringstream ossB;
-  ossB << "HeMcs" << mcsB;
-  for (int i = 0; i < nStaB; i++)
+    for (int t = s + 1; t < 3; t++)
+    {
+      double distance = 5 * std::abs (appliedConfig[s].channelNumber - appliedConfig[t].channelNumber); // MHz
+      if (distance < (appliedConfig[s].channelWidth + appliedConfig[t].channelWidth) / 2.0)
+        std::cout << WARNING << "Slices " << (char) ('A' + s) << " and " << (char) ('A' + t)
+                  << " overlap but use separate channels!" << ENDC << std::endl;
+    }
+  }
+}
+
+
+// function to store the configuration currently applied to the devices of each slice
+void store_applied_config()
+{
+  get_config (appliedConfig);
+  check_slice_bands();
+}
+
+
+// function to record a change applied to a slice in the journal
+void journal_change (int slice, std::string parameter, int oldValue, int newValue)
+{
+  journal << seed << "," << Simulator::Now ().GetSeconds () << "," << (char) ('A' + slice) << ","
+          << parameter << "," << oldValue << "," << newValue << std::endl;
+}
+
+
+// function to apply only the parameters which differ from the configuration applied to each slice
+void apply_channels()
+{
+  SliceConfig config[3];
+  get_config (config);
+  for (int s = 0; s < 3; s++)
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossB.str ()));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossB.str ()));
-  }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/1/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossB.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/1/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossB.str ()));
-  std::ostringstream ossC;
-  ossC << "HeMcs" << mcsC;
-  for (int i = 0; i < nStaC; i++)
+    bool numberChanged = config[s].channelNumber != appliedConfig[s].channelNumber;
+    if (numberChanged)
+    {
+      set_slice_channel_number (sliceDevices[s], config[s].channelNumber);
+      journal_change (s, "channelNumber", appliedConfig[s].channelNumber, config[s].channelNumber);
+    }
+    // The channel switch has reset the width to the default one of the new channel
+    if (config[s].channelWidth != appliedConfig[s].channelWidth
+        || (numberChanged && config[s].channelWidth != default_channel_width (config[s].channelNumber)))
+    {
+      set_slice_channel_width (sliceDevices[s], config[s].channelWidth);
+      if (config[s].channelWidth != appliedConfig[s].channelWidth)
+        journal_change (s, "channelWidth", appliedConfig[s].channelWidth, config[s].channelWidth);
+    }
+    if (config[s].txPower != appliedConfig[s].txPower)
+    {
+      set_slice_tx_power (sliceDevices[s], config[s].txPower);
+      journal_change (s, "txPower", appliedConfig[s].txPower, config[s].txPower);
+    }
+    if (config[s].gi != appliedConfig[s].gi)
+    {
+      set_slice_guard_interval (sliceDevices[s], config[s].gi);
+      journal_change (s, "gi", appliedConfig[s].gi, config[s].gi);
+    }
+    if (config[s].mcs != appliedConfig[s].mcs)
+    {
+      set_slice_mcs (sliceDevices[s], config[s].mcs);
+      journal_change (s, "mcs", appliedConfig[s].mcs, config[s].mcs);
+    }
+    appliedConfig[s] = config[s];
+  }
+  check_slice_bands();
+}
+
+
+// function to set the default journal file name (csvFileName with suffix _journal)
+void set_journal_file_name()
+{
+  if (journalFileName == "")
+  {
+    journalFileName = csvFileName;
+    if (journalFileName.size () > 4 && journalFileName.substr (journalFileName.size () - 4) == ".csv")
+      journalFileName.erase (journalFileName.size () - 4);
+    journalFileName += "_journal.csv";
+  }
+}
+
+
+// function to write the journal of the applied changes
+void write_journal()
+{
+  set_journal_file_name();
+  bool newFile = !std::ifstream (journalFileName.c_str ()).good ();
+  std::ofstream out (journalFileName.c_str (), std::ios::app);
+  if (newFile)
+    out << journalHeader << std::endl;
+  out << journal.str ();
+  out.close ();
+}
+
+
+// Control ticks
+EventId controlEvent;  // next periodic control tick
+EventId triggerEvent;  // controller run fired by the monitor
+int controlTick = 1;   // last control tick
+Time lastControl;      // time of the last controller run
+
+void update_channels (int i);
+
+
+// function to run the controller at once, since a slice has broken its SLA, or triggerHoldoff after its last run
+void sla_trigger()
+{
+  if (monitor.triggered || Simulator::Now () > Seconds (simulationTime))
+    return;
+  monitor.triggered = 1;
+  Time delay = Max (lastControl + Seconds (triggerHoldoff) - Simulator::Now (), Seconds (0));
+  triggerEvent = Simulator::Schedule (delay, &update_channels, controlTick + 1);
+}
+
+
+// function to add rx received and lost lost packets of STA sta, with their total delay [ms], to the SLA monitor
+void sla_observe (int sta, uint32_t rx, uint32_t lost, double delaySum)
+{
+  monitor.rx[sta] += rx;
+  monitor.lost[sta] += lost;
+  monitor.delaySum[sta] += delaySum;
+  uint32_t packets = monitor.rx[sta] + monitor.lost[sta];
+  if (packets < monitorMinPackets)
+    return;
+  double probErr = monitor.lost[sta] / (double) packets;
+  if (sta < nStaA)
+  {
+    if (probErr > probErrMaxA) sla_trigger();
+  }
+  else if (sta < nStaA + nStaB)
+  {
+    if (monitor.off[sta] != (probErr > probErrMaxB))
+    {
+      monitor.off[sta] = !monitor.off[sta];
+      monitor.offB += monitor.off[sta] ? 1 : -1;
+    }
+    if (monitor.offB > offMaxB*nStaB) sla_trigger();
+  }
+  else
+  {
+    if (probErr > probErrMaxC || monitor.delaySum[sta] / monitor.rx[sta] > latencyMaxC) sla_trigger();
+  }
+}
+
+
+// function to check whether every slice is well within its SLA on the current window (KPIs below slaMargin
+// times their bound), so that the periodic tick can be skipped. STAs without packets in the window are quiet
+bool sla_quiet()
+{
+  int nOffB = 0;
+  for (int sta = 0; sta < nStaA + nStaB + nStaC; sta++)
+  {
+    uint32_t packets = monitor.rx[sta] + monitor.lost[sta];
+    double probErr = packets > 0 ? monitor.lost[sta] / (double) packets : 0;
+    if (sta < nStaA)
+    {
+      if (probErr > slaMargin*probErrMaxA) return 0;
+    }
+    else if (sta < nStaA + nStaB)
+    {
+      if (probErr > slaMargin*probErrMaxB) nOffB++;
+    }
+    else
+    {
+      if (probErr > slaMargin*probErrMaxC) return 0;
+      if (monitor.rx[sta] > 0 && monitor.delaySum[sta] / monitor.rx[sta] > slaMargin*latencyMaxC) return 0;
+    }
+  }
+  return nOffB <= slaMargin*offMaxB*nStaB;
+}
+
+
+// function called by the Tx trace of the OnOff client of station sta
+void kpi_tx (int sta, Ptr<const Packet> packet)
+{
+  kpi.Tx (sta, packet);
+}
+
+
+// function called by the Rx trace of the UdpServer of station sta
+void kpi_rx (int sta, Ptr<const Packet> packet)
+{
+  KpiTimestampTag tag;
+  double delay;
+  if (kpi.Rx (sta, packet, tag, delay))
   {
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-                 StringValue (ossC.str ()));
-    Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+i) +
-                 "/DeviceList/0/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-                 StringValue (ossC.str ()));
-  }
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/2/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/DataMode",
-               StringValue (ossC.str ()));
-  Config::Set ("/NodeList/" + std::to_string(nStaA+nStaB+nStaC) +
-               "/DeviceList/2/$ns3::WifiNetDevice/RemoteStationManager/$ns3::ConstantRateWifiManager/ControlMode",
-               StringValue (ossC.str ()));
+    if (slaMonitor && tag.seq >= monitor.nextSeq[sta])
+    {
+      sla_observe (sta, 1, tag.seq - monitor.nextSeq[sta], delay);
+      monitor.nextSeq[sta] = tag.seq + 1;
+    }
+  }
+}
+
+
+BinWriter binWriter; // columnar binary output (binFileName)
+
+
+// function to write one chunk of the binary file
+void write_bin_chunk (BinChunkKind kind, int tick, double time)
+{
+  SliceConfig config[3];
+  get_config (config);
+  int nSta[3] = {nStaA, nStaB, nStaC};
+  const std::vector<int>* dataRate[3] = {&dataRateA, &dataRateB, &dataRateC};
+  binWriter.WriteChunk (runId, seed, kind, tick, time, nSta, config, dataRate, station);
 }
 
 
@@ -402,81 +780,528 @@ void new_application (uint16_t& index, NodeContainer staNodes, NodeContainer apN
   clientApp = client.Install (staNodes.Get (index-1));
   clientApp.Start (Seconds (1.0));
   clientApp.Stop (Seconds (simulationTime + 1));
+  if (kpiSource == "trace")
+  {
+    int sta = index - 1;
+    clientApp.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&kpi_tx, sta));
+    serverApp.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&kpi_rx, sta));
+  }
   index ++;
 }
 
 
-// function to update channel numbers, channel widths, GIs, MCSs, and Ptxs for each slice.
-void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
-                      NodeContainer staNodes, NodeContainer apNode)
+// function to read the KPIs of a new control window into the station store
+void read_stats()
 {
-  std::cout << "At time " << i << "s update_channels is called" << std::endl;
+  station.Advance ();
+  if (kpiSource == "trace")
+    station.ReadCollector (kpi);
+  else
+    station.ReadFlowStats (flowMonitor, flowHelper, flowStation, 5001);
+  station.ComputeProbErr ();
+}
 
-  // Compute Inputs: rx power through the path loss [dB] (meaningful only when mobility is involved), # of tx packets, # of rx packets and latency
 
+LossCache lossCache; // path loss from each STA to the AP
+
+
+// Analytical slice estimator: Bianchi's model of the DCF in saturation, with the RTS/CTS exchange protecting every
+// data frame (RtsCtsThreshold is 100 bytes) and the durations of the HE SU PPDUs of the slice configuration.
+// The STAs of a slice contend only while they have a packet queued (Little's law, solved by fixed point); when single
+// MPDUs cannot carry the load, every STA is backlogged and the A-MPDUs grow up to maxAmpduSize bytes.
+// A frame of a STA is decoded with a probability logistic in the margin of its rx power over the tab2 threshold
+// (3 dB higher per doubling of the width) and a packet is dropped after retryLimit failed attempts or when the load
+// exceeds the capacity of the slice. The delay is the exchange of one PPDU after the mean backoff plus the M/D/1
+// waiting time at the load of the slice (the time between two successes of a STA with A-MPDUs). Control frames are
+// timed as non-HT frames at 24 Mb/s.
+const int cwMin = 15;                 // min contention window
+const int cwMax = 1023;               // max contention window
+const int retryLimit = 7;             // max # of attempts of a frame
+const double slotTime = 9;            // us
+const double sifs = 16;               // us
+const double aifs = sifs + 3 * slotTime; // AIFS of AC_BE [us]
+const uint32_t maxAmpduSize = 65535;  // bytes
+const uint32_t mpduOverhead = 8 + 20 + 8 + 26 + 4; // UDP, IPv4, LLC/SNAP, QoS MAC header and FCS [bytes]
+const double marginSpread = 1;        // spread of the decoding probability around the tab2 threshold [dB]
+const double queueDelayMax = 500;     // max queueing delay [ms] (WifiMacQueue MaxDelay)
+
+// Estimate of the KPIs of a slice
+struct SliceEstimate
+{
+  double throughput; // delivered [Mb/s]
+  double probErr;    // Pe
+  double delay;      // mean delay [us]
+};
+
+
+// function to get the rx power a STA needs to decode the frames of a slice configuration, from tab2 [dBm]
+double tab2_threshold (const SliceConfig& config)
+{
+  return tab2[std::min (std::max (config.mcs, 0), 11)] + 10 * std::log10 (config.channelWidth / 20.0);
+}
+
+
+// function to get the probability of decoding a frame received margin dB above the tab2 threshold
+double decode_probability (double margin)
+{
+  return 1 / (1 + std::exp (-margin / marginSpread));
+}
+
+
+// function to get the duration of a HE SU PPDU carrying bytes bytes [us]
+double he_ppdu_duration (const SliceConfig& config, uint32_t bytes)
+{
+  static const double bitsPerTone[12] = {0.5, 1, 1.5, 2, 3, 4, 4.5, 5, 6, 20 / 3.0, 7.5, 25 / 3.0};
+  int dataTones = config.channelWidth == 20 ? 234 : config.channelWidth == 40 ? 468 : config.channelWidth == 80 ? 980 : 1960;
+  double bitsPerSymbol = dataTones * bitsPerTone[std::min (std::max (config.mcs, 0), 11)];
+  double symbols = std::ceil ((16 + 8.0 * bytes + 6) / bitsPerSymbol); // SERVICE, PSDU and tail bits
+  return 44 + symbols * (12.8 + config.gi / 1000.0); // L-STF, L-LTF, L-SIG, RL-SIG, HE-SIG-A, HE-STF, one HE-LTF
+}
+
+
+// function to get the duration of a non-HT control frame of bytes bytes at 24 Mb/s [us]
+double control_duration (uint32_t bytes)
+{
+  return 20 + 4 * std::ceil ((16 + 8.0 * bytes + 6) / 96);
+}
+
+
+// function to get the duration of the medium lost in a collision of RTSs, up to the CTS timeout [us]
+double rts_collision_duration()
+{
+  return control_duration (20) + sifs + control_duration (14) + aifs;
+}
+
+
+// function to get the attempt probability of a DCF station whose attempts collide with probability p (Bianchi)
+double dcf_attempt (double p)
+{
+  double w = cwMin + 1;
+  int m = (int) std::round (std::log2 ((cwMax + 1) / w));
+  if (std::abs (1 - 2 * p) < 1e-9)
+    return 2 / (1 + w + w * m / 2);
+  return 2 * (1 - 2 * p) / ((1 - 2 * p) * (w + 1) + p * w * (1 - std::pow (2 * p, m)));
+}
+
+
+// function to get the collision probability of a DCF station contending with n - 1 saturated stations (Bianchi)
+double dcf_collision (double n)
+{
+  if (n <= 1)
+    return 0;
+  double low = 0, high = 1;
+  for (int k = 0; k < 50; k++)
+  {
+    double p = (low + high) / 2;
+    if (1 - std::pow (1 - dcf_attempt (p), n - 1) > p)
+      low = p;
+    else
+      high = p;
+  }
+  return (low + high) / 2;
+}
+
+
+// Medium of a slice seen by the estimator
+struct DcfMedium
+{
+  double collision; // collision probability of an attempt
+  double capacity;  // delivered payload [Mb/s]
+  double exchange;  // duration of a successful exchange (RTS, CTS, PPDU, Ack) [us]
+  double cycle;     // time between two successes of a STA [us]
+};
+
+
+// function to get the medium of a slice with active contending STAs sending PPDUs of mpdus MPDUs,
+// decoded with probability decode
+DcfMedium dcf_medium (const SliceConfig& config, double active, int mpdus, double decode)
+{
+  uint32_t mpdu = payloadSize + mpduOverhead + 4; // with the A-MPDU delimiter
+  double ack = control_duration (mpdus > 1 ? 32 : 14); // BlockAck or Ack
+  DcfMedium medium;
+  medium.collision = dcf_collision (active);
+  double tau = dcf_attempt (medium.collision);
+  double transmit = 1 - std::pow (1 - tau, active);                          // some STA transmits in a slot
+  double success = active * tau * std::pow (1 - tau, active - 1) / transmit; // only one of them does
+  medium.exchange = control_duration (20) + sifs + control_duration (14) + sifs
+                    + he_ppdu_duration (config, mpdus * mpdu) + sifs + ack + aifs;
+  double slot = (1 - transmit) * slotTime + transmit * success * medium.exchange
+                + transmit * (1 - success) * rts_collision_duration ();
+  medium.capacity = transmit * success * mpdus * payloadSize * 8 * decode / slot;
+  medium.cycle = active * slot / (transmit * success);
+  return medium;
+}
+
+
+// function to estimate the KPIs of slice s (0, 1 or 2) with the configuration config
+SliceEstimate estimate_slice (int s, const SliceConfig& config)
+{
+  int first[4] = {0, nStaA, nStaA + nStaB, nStaA + nStaB + nStaC};
+  int dataRateSum[3] = {dataRateSumA, dataRateSumB, dataRateSumC};
+  double dataRateUnit[3] = {1e6, 1e3, 1e6}; // Mb/s, Kb/s, Mb/s
+  int n = first[s + 1] - first[s];
+  double offered = dataRateSum[s] * dataRateUnit[s] / 1e6; // Mb/s
+  SliceEstimate estimate = {0, 0, 0};
+  if (n == 0 || offered == 0)
+    return estimate;
+
+  std::vector<double> decode (n);
+  double decodeMean = 0;
+  for (int i = 0; i < n; i++)
+  {
+    decode[i] = decode_probability (config.txPower - lossCache.Get (first[s] + i) - tab2_threshold (config));
+    decodeMean += decode[i] / n;
+  }
+
+  // Single MPDUs: the STAs with a packet queued (Little's law) contend
+  double active = 1, load = 0;
+  DcfMedium medium;
+  for (int k = 0; k < 30; k++)
+  {
+    medium = dcf_medium (config, active, 1, decodeMean);
+    load = offered / medium.capacity;
+    if (load >= 1)
+      break;
+    double service = payloadSize * 8 / medium.capacity; // medium time of a packet [us]
+    estimate.delay = cwMin / 2.0 * slotTime + medium.exchange + load * service / (2 * (1 - load));
+    active = (active + std::max (1.0, std::min ((double) n, offered / (payloadSize * 8) * estimate.delay))) / 2;
+  }
+  // Beyond the capacity of single MPDUs, every STA is backlogged and the A-MPDUs grow until the slice carries its load
+  if (load >= 1)
+  {
+    int aggregate = std::max ((int) (maxAmpduSize / (payloadSize + mpduOverhead + 4)), 1);
+    for (int mpdus = 2; mpdus <= aggregate; mpdus++)
+    {
+      medium = dcf_medium (config, n, mpdus, decodeMean);
+      if (medium.capacity >= offered)
+        break;
+    }
+    load = offered / medium.capacity;
+    estimate.delay = load < 1 ? medium.cycle + medium.exchange : queueDelayMax * 1000;
+  }
+
+  double delivered = 0;
+  for (int i = 0; i < n; i++)
+    delivered += (1 - std::pow (1 - (1 - medium.collision) * decode[i], retryLimit)) / n;
+  if (load > 1)
+    delivered /= load;
+  estimate.probErr = std::max (1 - delivered, 0.0);
+  estimate.throughput = offered * delivered;
+  return estimate;
+}
+
+
+// Abstract PHY (phyModel=abstract): the medium of each slice is modelled at the frame level every abstractStep seconds,
+// without devices, stack or applications. The packets offered by the OnOff rate of a STA in a step need the airtime
+// of the tab1 rate of the slice configuration. An attempt succeeds if it does not collide (collision probability of
+// the estimator, for the stations active at the load of the slice in the previous step, a collision costing the RTS
+// exchange only) and if the frame is decoded, with the decoding probability of the estimator. Failed attempts are
+// retried up to retryLimit times and the packets beyond the airtime of the step are dropped. The latency is the
+// service time plus the M/D/1 waiting time at the load of the slice. Slices do not interfere. The results feed the
+// KPI collector, so that the controller and the output are those of the full PHY.
+double sliceLoad[3] = {0, 0, 0};      // load of the medium of each slice in the previous step
+std::vector<double> abstractCredit;   // packets offered by each STA and not yet sent (less than one)
+Ptr<UniformRandomVariable> abstractUniform;
+Ptr<NormalRandomVariable> abstractNormal;
+
+
+// function to get the rate of a slice configuration from tab1 [Mb/s]
+double tab1_rate (const SliceConfig& config)
+{
+  int column = 2 * (int) log2 (config.channelWidth / 20) + (config.gi == 800 ? 1 : 0);
+  return tab1[std::min (std::max (config.mcs, 0), 11)][column];
+}
+
+
+// function to draw the # of successes of n trials with probability p (normal approximation for large n)
+uint32_t draw_binomial (uint32_t n, double p)
+{
+  if (n < 30)
+  {
+    uint32_t k = 0;
+    for (uint32_t j = 0; j < n; j++)
+      k += abstractUniform->GetValue () < p;
+    return k;
+  }
+  double k = std::round (n * p + std::sqrt (n * p * (1 - p)) * abstractNormal->GetValue ());
+  return (uint32_t) std::min (std::max (k, 0.0), (double) n);
+}
+
+
+// function to simulate one step of the abstract PHY, from the start to the end of the traffic
+void abstract_step()
+{
+  int first[4] = {0, nStaA, nStaA + nStaB, nStaA + nStaB + nStaC};
+  std::vector<int>* dataRate[3] = {&dataRateA, &dataRateB, &dataRateC};
+  double dataRateUnit[3] = {1e6, 1e3, 1e6}; // Mb/s, Kb/s, Mb/s
+  for (int s = 0; s < 3; s++)
+  {
+    int n = first[s + 1] - first[s];
+    const SliceConfig& config = appliedConfig[s];
+    double dataTime = payloadSize * 8 / (tab1_rate (config) * 1e6); // airtime of an attempt [s]
+    double collisionTime = rts_collision_duration () / 1e6; // [s]
+    double collision = dcf_collision (std::max (1.0, n * std::min (sliceLoad[s], 1.0)));
+    std::vector<uint32_t> offered (n);
+    std::vector<double> delivery (n), service (n);
+    double demand = 0;
+    uint32_t offeredSum = 0;
+    for (int i = 0; i < n; i++)
+    {
+      int sta = first[s] + i;
+      abstractCredit[sta] += (*dataRate[s])[i] * dataRateUnit[s] * abstractStep / (payloadSize * 8);
+      offered[i] = (uint32_t) abstractCredit[sta];
+      abstractCredit[sta] -= offered[i];
+      double fail = 1 - (1 - collision) * decode_probability (config.txPower - lossCache.Get (sta) - tab2_threshold (config));
+      double attempts = fail < 1 ? (1 - std::pow (fail, retryLimit)) / (1 - fail) : retryLimit;
+      delivery[i] = 1 - std::pow (fail, retryLimit);
+      service[i] = attempts * (collision * collisionTime + (1 - collision) * dataTime);
+      demand += offered[i] * service[i];
+      offeredSum += offered[i];
+    }
+    sliceLoad[s] = demand / abstractStep;
+    double served = sliceLoad[s] > 1 ? 1 / sliceLoad[s] : 1;
+    double wait = queueDelayMax;
+    if (sliceLoad[s] < 1 && offeredSum > 0)
+      wait = std::min (sliceLoad[s] * demand / offeredSum / (2 * (1 - sliceLoad[s])) * 1000, queueDelayMax);
+    for (int i = 0; i < n; i++)
+    {
+      int sta = first[s] + i;
+      uint32_t rx = draw_binomial (offered[i], delivery[i] * served);
+      kpi.txPackets[sta] += offered[i];
+      kpi.rxPackets[sta] += rx;
+      kpi.delaySum[sta] += rx * (service[i] * 1000 + wait);
+      if (slaMonitor)
+        sla_observe (sta, rx, offered[i] - rx, rx * (service[i] * 1000 + wait));
+    }
+  }
+  if (Simulator::Now () + Seconds (abstractStep) < Seconds (simulationTime + 1))
+    Simulator::Schedule (Seconds (abstractStep), &abstract_step);
+}
+
+
+// Built-in slice controller of the dynamic network slicing approach, used when no controller library is given.
+// Initialize sizes each slice from tab1 and tab2; Update adapts the configuration to the SLA of each slice
+// on the last two control windows
+class DynamicSliceController : public SliceController
+{
+public:
+  virtual void Initialize (const KpiSnapshot& kpi, SliceConfig config[3]);
+  virtual void Update (const KpiSnapshot& kpi, SliceConfig config[3]);
+
+private:
+  int mcsA_min = 0;
+  int mcsA_max = 11;
+  int mcsC_min = 0;
+  int mcsC_max = 11;
+  int channelWidthMulA = 1;
+  int mcsAddB = 1;
+  int txPowerAddB = 3;
+  int channelWidthMulC = 1;
+};
+
+
+void DynamicSliceController::Initialize (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  // The outputs keep the names of the global configuration
+  int& channelNumberA = config[0].channelNumber;
+  int& channelWidthA = config[0].channelWidth;
+  int& giA = config[0].gi;
+  int& mcsA = config[0].mcs;
+  int& txPowerA = config[0].txPower;
+  int& channelNumberB = config[1].channelNumber;
+  int& channelWidthB = config[1].channelWidth;
+  int& giB = config[1].gi;
+  int& mcsB = config[1].mcs;
+  int& txPowerB = config[1].txPower;
+  int& channelNumberC = config[2].channelNumber;
+  int& channelWidthC = config[2].channelWidth;
+  int& giC = config[2].gi;
+  int& mcsC = config[2].mcs;
+  int& txPowerC = config[2].txPower;
+  int nStaA = kpi.nSta[0], nStaB = kpi.nSta[1], nStaC = kpi.nSta[2];
+  int dataRateSumA = kpi.dataRateSum[0], dataRateSumB = kpi.dataRateSum[1], dataRateSumC = kpi.dataRateSum[2];
+  std::vector<double> rxPower (kpi.rxPower, kpi.rxPower + nStaA + nStaB + nStaC);
+
+  // Slice A
+  txPowerA = 20; // Maximum power
+  giA = 800; // Minimum GI
   for (int i = 0; i < nStaA; i++)
   {
-    rxPower[i] = txPowerA - lossModel->GetLoss (staNodes.Get(i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
+    rxPower[i] = txPowerA - kpi.loss[i];
     //std::cout << "Received power A: " << rxPower[i] << std::endl;
   }
+  double rxPowerA_min = 20;
+  for (int i = 0; i < nStaA; i++)
+  {
+    if (rxPower[i] < rxPowerA_min) rxPowerA_min = rxPower[i];
+  }
+  // max MCS according to tab2
+  for (int i = 0; i < 12; i++)
+  {
+    if (tab2[i] > rxPowerA_min)
+    {
+      mcsA_max = i-2;
+      break;
+    }
+    mcsA_max = 11;
+  }
+  // min channelWidth according to tab1
+  if (dataRateSumA < tab1[mcsA_max][1])
+  {
+    channelWidthA = 20;
+    channelNumberA = 36;
+  }
+  else if (dataRateSumA < tab1[mcsA_max][3])
+  {
+    channelWidthA = 40;
+    channelNumberA = 38;
+  }
+  else if (dataRateSumA < tab1[mcsA_max][5])
+  {
+    channelWidthA = 80;
+    channelNumberA = 42;
+  }
+  else
+  {
+    channelWidthA = 160;
+    channelNumberA = 50;
+  }
+  // min MCS allowed by channelWidthA from tab1
+  for (int i = 0; i < 12; i++)
+  {
+    if (dataRateSumA < tab1[i][2* (int) log2(channelWidthA/10)-1])
+    {
+      mcsA_min = i;
+      break;
+    }
+    mcsA_min = 11;
+  }
+  // min MCS
+  if (mcsA_max >= mcsA_min + 1) mcsA = mcsA_min + 1;
+  else mcsA = mcsA_max;
+  *log << "Slice A: " << channelWidthA << ", " << channelNumberA <<
+               ", " << giA << ", " << mcsA << ", " << txPowerA << std::endl;
+  *log << "Slice A mcs: " << mcsA_min << ", " << mcsA_max << std::endl;
+
+  // Slice B
+  channelWidthB = 20;
+  channelNumberB = 100;
+  giB = 1600;
+  // min MCS according to tab1
+  for (int i = 0; i < 12; i++)
+  {
+  	if (tab1[i][0] > dataRateSumB/1000)
+    {
+      mcsB = i+1;
+      break;
+    }
+    mcsB = 11;
+  }
+  // min txPower according to tab2
+  std::vector<double> lossB(nStaB);
   for (int i = 0; i < nStaB; i++)
   {
-    rxPower[nStaA+i] = txPowerB - lossModel->GetLoss (staNodes.Get(nStaA+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power B: " << rxPower[nStaA+i] << std::endl;
+  	lossB[i] = kpi.loss[nStaA+i];
   }
+  sort(lossB.begin(), lossB.end());
+  txPowerB = lossB[nStaB - nStaB/10 - 1] + tab2[mcsB] + 3;
+  *log << "Slice B: " << channelWidthB << ", " << channelNumberB <<
+               ", " << giB << ", " << mcsB << ", " << txPowerB << std::endl;
+
+  // Slice C
+  txPowerC = 20; // Maximum power
+  giC = 800; // Minimum GI
   for (int i = 0; i < nStaC; i++)
   {
-    rxPower[nStaA+nStaB+i] = txPowerC - lossModel->GetLoss (staNodes.Get(nStaA+nStaB+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
+    rxPower[nStaA+nStaB+i] = txPowerC - kpi.loss[nStaA+nStaB+i];
     //std::cout << "Received power C: " << rxPower[nStaA+nStaB+i] << std::endl;
   }
-  //flowMonitor->CheckForLostPackets ();
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
-  FlowMonitor::FlowStatsContainer stats = flowMonitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
-  {
-    txPackets_unsort[i->first-1] = i->second.txPackets;
-    rxPackets_unsort[i->first-1] = i->second.rxPackets;
-    latency_unsort[i->first-1] = i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets;
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    destPorts[i->first-1] = t.destinationPort;
-    //std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << "," << destPorts[i->first-1] << ")\n";
-    //std::cout << "  Tx Packets: " << totTxPackets[i->first-1] << "\n";
-    //std::cout << "  Rx Packets: " << totRxPackets[i->first-1] << "\n";
-    //std::cout << "  Delay Sum: " << totDelay[i->first-1] << "\n";
-    //std::cout << "  Delay Sum MS: " << i->second.delaySum.ToDouble(Time::MS) << "\n";
-    //std::cout << "  Delay: " << i->second.delaySum / i->second.rxPackets << "\n";
-    //std::cout << "  Delay MS: " << i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets << "\n";
-  }
-  // Shift txPackets, rxPackets, latency and probErr
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  double rxPowerC_min = 20;
+  for (int i = 0; i < nStaC; i++)
   {
-  	txPackets[1][i] = txPackets[0][i];
-  	rxPackets[1][i] = rxPackets[0][i];
-  	latency[1][i] = latency[0][i];
-  	probErr[1][i] = probErr[0][i];
+  	if (rxPower[nStaA+nStaB+i] < rxPowerC_min) rxPowerC_min = rxPower[nStaA+nStaB+i];
   }
-  // Compute txPackets, rxPackets, latency and probErr
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  // max MCS according to tab2
+  for (int i = 0; i < 12; i++)
+  {
+  	if (tab2[i] > rxPowerC_min)
+    {
+      mcsC_max = i-2;
+      break;
+    }
+    mcsC_max = 11;
+  }
+  // min channelWidth according to tab1
+  if (dataRateSumC < tab1[mcsC_max][1])
   {
-    txPackets[0][destPorts[i]-5001] = txPackets_unsort[i];
-    rxPackets[0][destPorts[i]-5001] = rxPackets_unsort[i];
-    latency[0][destPorts[i]-5001] = latency_unsort[i];
+    channelWidthC = 20;
+    channelNumberC = 161;
   }
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  else if (dataRateSumC < tab1[mcsC_max][3])
+  {
+    channelWidthC = 40;
+    channelNumberC = 159;
+  }
+  else if (dataRateSumC < tab1[mcsC_max][5])
+  {
+    channelWidthC = 80;
+    channelNumberC = 155;
+  }
+  else
+  {
+    channelWidthC = 160;
+    channelNumberC = 144;
+  }
+  // min MCS allowed by channelWidthC from tab1
+  for (int i = 0; i < 12; i++)
   {
-  	// probErr[0][i] = (txPackets[0][i] - rxPackets[0][i]) / (double)txPackets[0][i];
-    probErr[0][i] = ((txPackets[0][i]-txPackets[1][i]) - (rxPackets[0][i]-rxPackets[1][i])) / (double)(txPackets[0][i]-txPackets[1][i]);
-    std::cout << "Error Prob: " << probErr[0][i] << std::endl;
+    if (dataRateSumC < tab1[i][2* (int) log2(channelWidthC/10)-1])
+    {
+      mcsC_min = i;
+      break;
+    }
+    mcsC_min = 11;
   }
+  // MCS
+  if (mcsC_max >= mcsC_min + 1) mcsC = mcsC_max;
+  else mcsC = mcsC_min + 1;
+  *log << "Slice C: " << channelWidthC << ", " << channelNumberC <<
+               ", " << giC << ", " << mcsC << ", " << txPowerC << std::endl;
+  *log << "Slice C mcs: " << mcsC_min << ", " << mcsC_max << std::endl;
+}
+
+
+void DynamicSliceController::Update (const KpiSnapshot& kpi, SliceConfig config[3])
+{
+  // The outputs keep the names of the global configuration
+  int& channelNumberA = config[0].channelNumber;
+  int& channelWidthA = config[0].channelWidth;
+  int& giA = config[0].gi;
+  int& mcsA = config[0].mcs;
+  int& txPowerA = config[0].txPower;
+  int& channelNumberB = config[1].channelNumber;
+  int& channelWidthB = config[1].channelWidth;
+  int& giB = config[1].gi;
+  int& mcsB = config[1].mcs;
+  int& txPowerB = config[1].txPower;
+  int& channelNumberC = config[2].channelNumber;
+  int& channelWidthC = config[2].channelWidth;
+  int& giC = config[2].gi;
+  int& mcsC = config[2].mcs;
+  int& txPowerC = config[2].txPower;
+  int nStaA = kpi.nSta[0], nStaB = kpi.nSta[1], nStaC = kpi.nSta[2];
+  int dataRateSumA = kpi.dataRateSum[0], dataRateSumB = kpi.dataRateSum[1], dataRateSumC = kpi.dataRateSum[2];
 
   // Compute Outputs: channel number, channel width, guard interval, mcs, tx power
+  const double* const* probErr = kpi.probErr; // Pe on the last two windows
+  const double* const* latency = kpi.latency;
 
   // Slice A, goal: reach high throughput
-  sliceA = 1;
-  sliceA_improved = 0;
+  bool sliceA = 1;
+  bool sliceA_improved = 0;
   for (int i = 0; i < nStaA; i++)
   {
-    if (probErr[0][i] > 0.02)
+    if (probErr[0][i] > probErrMaxA)
     {
       sliceA = 0;
       break;
@@ -501,7 +1326,7 @@ void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
   double rxPowerA_min = 20;
   for (int i = 0; i < nStaA; i++)
   {
-    if (rxPower[i] < rxPowerA_min) rxPowerA_min = rxPower[i];
+    if (kpi.rxPower[i] < rxPowerA_min) rxPowerA_min = kpi.rxPower[i];
   }
   // max MCS according to tab2
   for (int i = 0; i < 12; i++)
@@ -535,21 +1360,21 @@ void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
   // min MCS
   if (mcsA_max >= mcsA_min + 1) mcsA = mcsA_min + 1;
   else mcsA = mcsA_max;
-  std::cout << "Slice A: " << channelWidthA << ", " << channelNumberA <<
+  *log << "Slice A: " << channelWidthA << ", " << channelNumberA <<
                ", " << giA << ", " << mcsA << ", " << txPowerA << std::endl;
-  std::cout << "Slice A mcs: " << mcsA_min << ", " << mcsA_max << std::endl;
+  *log << "Slice A mcs: " << mcsA_min << ", " << mcsA_max << std::endl;
 
 
 
   // Slice B, goal: use the lowest txPower possible without losing in resource utilization
-  sliceB = 1;
-  sliceB_improved = 0;
+  bool sliceB = 1;
+  bool sliceB_improved = 0;
   int nSliceB_off = 0;
   for (int i = 0; i < nStaB; i++)
   {
-    if (probErr[0][nStaA+i] > 0.02) nSliceB_off++;
+    if (probErr[0][nStaA+i] > probErrMaxB) nSliceB_off++;
   }
-  if (nSliceB_off > nStaB/10) sliceB = 0;
+  if (nSliceB_off > offMaxB*nStaB) sliceB = 0;
   double probErrSumB = 0;
   for (int i = 0; i < nStaB; i++)
   {
@@ -590,22 +1415,22 @@ void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
   std::vector<double> lossB(nStaB);
   for (int i = 0; i < nStaB; i++)
   {
-  	lossB[i] = lossModel->GetLoss (staNodes.Get(nStaA+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
+  	lossB[i] = kpi.loss[nStaA+i];
   }
   sort(lossB.begin(), lossB.end());
   txPowerB = lossB[nStaB - nStaB/10 - 1] + tab2[mcsB] + txPowerAddB;
-  std::cout << "Slice B: " << channelWidthB << ", " << channelNumberB <<
+  *log << "Slice B: " << channelWidthB << ", " << channelNumberB <<
                ", " << giB << ", " << mcsB << ", " << txPowerB << std::endl;
 
 
 
   // Slice C, goal: reach high reliability and low latency
   
-  sliceC = 1;
-  sliceC_improved = 0;
+  bool sliceC = 1;
+  bool sliceC_improved = 0;
   for (int i = 0; i < nStaC; i++)
   {
-    if (probErr[0][nStaA+nStaB+i] > 0.01 || latency[0][nStaA+nStaB+i] > 5)
+    if (probErr[0][nStaA+nStaB+i] > probErrMaxC || latency[0][nStaA+nStaB+i] > latencyMaxC)
     {
       sliceC = 0;
       break;
@@ -631,7 +1456,7 @@ void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
   double rxPowerC_min = 20;
   for (int i = 0; i < nStaC; i++)
   {
-  	if (rxPower[nStaA+nStaB+i] < rxPowerC_min) rxPowerC_min = rxPower[nStaA+nStaB+i];
+  	if (kpi.rxPower[nStaA+nStaB+i] < rxPowerC_min) rxPowerC_min = kpi.rxPower[nStaA+nStaB+i];
   }
   // max MCS according to tab2
   for (int i = 0; i < 12; i++)
@@ -665,212 +1490,544 @@ void update_channels (int i, Ptr<HybridBuildingsPropagationLossModel> lossModel,
   // MCS
   if (mcsC_max >= mcsC_min + 1) mcsC = mcsC_max;
   else mcsC = mcsC_min + 1;
-  std::cout << "Slice C: " << channelWidthC << ", " << channelNumberC <<
+  *log << "Slice C: " << channelWidthC << ", " << channelNumberC <<
                ", " << giC << ", " << mcsC << ", " << txPowerC << std::endl;
-  std::cout << "Slice C mcs: " << mcsC_min << ", " << mcsC_max << std::endl;
+  *log << "Slice C mcs: " << mcsC_min << ", " << mcsC_max << std::endl;
+}
 
 
+SliceController* sliceController = 0; // controller computing the slice configurations
+KpiSnapshot snapshot;                 // KPIs handed to the controller
+std::vector<int> snapshotDataRate;    // data rates of the STAs A, B and C
+std::vector<const uint32_t*> snapshotTxPackets;
+std::vector<const uint32_t*> snapshotRxPackets;
+std::vector<const double*> snapshotLatency;
+std::vector<const double*> snapshotProbErr;
 
-  // Set Outputs
-  set_channel_number();
-  set_channel_width();
-  set_tx_power();
-  set_guard_interval();
-  set_mcs();
 
-  // Write file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
-  out << "channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
+// function to create the slice controller, the built-in one or the one of controllerLibrary
+// The library is never unloaded, since the code of its controller lives in it. Returns 0 if it cannot be loaded
+int load_controller()
+{
+  delete sliceController;
+  sliceController = 0;
+  if (controllerLibrary == "")
+  {
+    sliceController = new DynamicSliceController ();
+    return 1;
+  }
+  void* library = dlopen (controllerLibrary.c_str (), RTLD_NOW | RTLD_LOCAL);
+  if (!library)
+  {
+    std::cout << ERROR << "Cannot load " << controllerLibrary << ": " << dlerror () << ENDC << std::endl;
+    return 0;
+  }
+  CreateSliceControllerFunction create = (CreateSliceControllerFunction) dlsym (library, "CreateSliceController");
+  if (create)
+    sliceController = create (controllerArgs.c_str ());
+  if (!sliceController)
+  {
+    std::cout << ERROR << "No controller created by " << controllerLibrary << "!" << ENDC << std::endl;
+    return 0;
+  }
+  std::cout << OKBLUE << "Slice controller: " << controllerLibrary << " " << controllerArgs << ENDC << std::endl;
+  return 1;
+}
+
+
+// function to fill the snapshot handed to the controller from the station store
+// The rx power of each STA must have been computed with the applied tx power
+void take_snapshot (int tick)
+{
+  int nSta = nStaA + nStaB + nStaC;
+  if (snapshotDataRate.empty ())
+  {
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateA.begin (), dataRateA.end ());
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateB.begin (), dataRateB.end ());
+    snapshotDataRate.insert (snapshotDataRate.end (), dataRateC.begin (), dataRateC.end ());
+  }
+  for (int i = 0; i < nSta; i++)
+    pathLoss[i] = lossCache.Get (i);
+  snapshotTxPackets.resize (station.historyLength);
+  snapshotRxPackets.resize (station.historyLength);
+  snapshotLatency.resize (station.historyLength);
+  snapshotProbErr.resize (station.historyLength);
+  for (int k = 0; k < station.historyLength; k++)
+  {
+    snapshotTxPackets[k] = station.TxPackets (k);
+    snapshotRxPackets[k] = station.RxPackets (k);
+    snapshotLatency[k] = station.Latency (k);
+    snapshotProbErr[k] = station.ProbErr (k);
+  }
+  snapshot.time = Simulator::Now ().GetSeconds ();
+  snapshot.tick = tick;
+  snapshot.nSta[0] = nStaA;
+  snapshot.nSta[1] = nStaB;
+  snapshot.nSta[2] = nStaC;
+  snapshot.dataRateSum[0] = dataRateSumA;
+  snapshot.dataRateSum[1] = dataRateSumB;
+  snapshot.dataRateSum[2] = dataRateSumC;
+  snapshot.dataRate = snapshotDataRate.data ();
+  snapshot.x = station.x.data ();
+  snapshot.y = station.y.data ();
+  snapshot.loss = pathLoss.data ();
+  snapshot.rxPower = station.rxPower.data ();
+  snapshot.historyLength = station.historyLength;
+  snapshot.txPackets = snapshotTxPackets.data ();
+  snapshot.rxPackets = snapshotRxPackets.data ();
+  snapshot.latency = snapshotLatency.data ();
+  snapshot.probErr = snapshotProbErr.data ();
+  for (int s = 0; s < 3; s++)
+    snapshot.applied[s] = appliedConfig[s];
+}
+
+
+// function to move each slice whose channel number does not match its channel width to the channel used by the
+// built-in controller for that width (pinConfig), so that a width given alone is not set on the channel of another width
+void pin_channel_numbers (SliceConfig config[3])
+{
+  const int plan[3][4] = {{36, 38, 42, 50}, {100, 102, 106, 114}, {161, 159, 155, 144}}; // 20, 40, 80 and 160 MHz
+  if (band == "AX_2.4")
+    return;
+  for (int s = 0; s < 3; s++)
+  {
+    int w = config[s].channelWidth >= 20 ? (int) log2 (config[s].channelWidth / 20) : -1;
+    if (default_channel_width (config[s].channelNumber) != config[s].channelWidth && w >= 0 && w < 4)
+      config[s].channelNumber = plan[s][w];
+  }
+}
+
+
+// function to get the initial configuration of the slices from the controller, or from the command line with pinConfig
+void initialize_controller()
+{
+  // Compute Inputs: rx power through the path loss [dB] with the current tx power
+  for (int i = 0; i < nStaA; i++)
+    station.rxPower[i] = txPowerA - lossCache.Get (i);
+  for (int i = 0; i < nStaB; i++)
+    station.rxPower[nStaA+i] = txPowerB - lossCache.Get (nStaA+i);
+  for (int i = 0; i < nStaC; i++)
+    station.rxPower[nStaA+nStaB+i] = txPowerC - lossCache.Get (nStaA+nStaB+i);
+
+  // Compute Outputs: channel number, channel width, guard interval, mcs, tx power
+  take_snapshot (0);
+  SliceConfig config[3];
+  get_config (config);
+  if (pinConfig)
+    pin_channel_numbers (config);
+  else
+    sliceController->Initialize (snapshot, config);
+  set_config (config);
+}
+
+
+// Decision of the controller computed by a worker thread (asyncController), while the simulation goes on.
+// The simulation only checks every asyncPollStep whether the worker has finished, without ever waiting for it:
+// the decision is applied decisionDelay after the KPIs were sampled or, with a negative decisionDelay, at sample
+// time plus compute time. When the simulation has already gone past that time (it runs faster than the worker),
+// the decision is applied as soon as it is seen. The output of the controller is printed when it is applied
+AsyncDecision decision;
+
+
+// function to apply the decision of the worker
+void apply_decision()
+{
+  decision.Join ();
+  decision.pending = 0;
+  std::cout << "At time " << Simulator::Now ().GetSeconds () << "s the decision of tick " << decision.tick
+            << " is applied (compute time " << decision.computeTime << "s)" << std::endl;
+  set_config (decision.config);
+  apply_channels();
+}
+
+
+// function to check every asyncPollStep whether the worker has finished, and then to apply its decision
+// at its time or at once if that time is past
+void poll_decision()
+{
+  if (!decision.Ready ())
+  {
+    Simulator::Schedule (Seconds (asyncPollStep), &poll_decision);
+    return;
+  }
+  Time apply = decision.sampleTime + Seconds (decisionDelay >= 0 ? decisionDelay : decision.computeTime);
+  Simulator::Schedule (Max (apply - Simulator::Now (), Seconds (0)), &apply_decision);
+}
+
+
+// function to start the worker on the snapshot of tick
+void request_decision (int tick)
+{
+  if (decision.pending)
+  {
+    std::cout << "The decision of tick " << decision.tick << " is still pending, tick " << tick << " is not evaluated" << std::endl;
+    return;
+  }
+  SliceConfig config[3];
+  get_config (config);
+  decision.Start (sliceController, snapshot, config, tick);
+  Simulator::Schedule (Seconds (std::max (decisionDelay, 0.0)), &poll_decision);
+}
+
+
+// function to write the rows of a control tick: the configuration of each slice, then the KPIs of each STA
+// until the tick. The header of a tick skipped by the SLA monitor starts with skipped_, so that the files keep
+// one block of rows per control period
+void write_tick (bool skipped, const uint32_t* txPackets, const uint32_t* rxPackets, const double* latency)
+{
+  std::ostream& out = writer.Buffer ();
+  out << (skipped ? "skipped_" : "") << "channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
   out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
   out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
   out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
   for (int i = 0; i < nStaA; i++)
   {
-    out << dataRateA[i] << "," << x[i] << "," << y[i] << ","
-    << txPackets[0][i] << "," << rxPackets[0][i] << "," << latency[0][i]
+    out << dataRateA[i] << "," << station.x[i] << "," << station.y[i] << ","
+    << txPackets[i] << "," << rxPackets[i] << "," << latency[i]
     << std::endl;
   }
   for (int i = 0; i < nStaB; i++)
   {
-    out << dataRateB[i] << "," << x[nStaA+i] << "," << y[nStaA+i] << ","
-    << txPackets[0][nStaA+i] << "," << rxPackets[0][nStaA+i] << "," << latency[0][nStaA+i] << std::endl;
+    out << dataRateB[i] << "," << station.x[nStaA+i] << "," << station.y[nStaA+i] << ","
+    << txPackets[nStaA+i] << "," << rxPackets[nStaA+i] << "," << latency[nStaA+i] << std::endl;
   }
   for (int i = 0; i < nStaC; i++)
   {
-    out << dataRateC[i] << "," << x[nStaA+nStaB+i] << "," << y[nStaA+nStaB+i] << ","
-    << txPackets[0][nStaA+nStaB+i] << "," << rxPackets[0][nStaA+nStaB+i] << "," << latency[0][nStaA+nStaB+i] << std::endl;
+    out << dataRateC[i] << "," << station.x[nStaA+nStaB+i] << "," << station.y[nStaA+nStaB+i] << ","
+    << txPackets[nStaA+nStaB+i] << "," << rxPackets[nStaA+nStaB+i] << "," << latency[nStaA+nStaB+i] << std::endl;
   }
-  out.close ();
+  writer.Commit ();
 }
 
 
-// function to compute channel numbers and widths for each slice
-void compute_channels (Ptr<HybridBuildingsPropagationLossModel> lossModel,
-                      NodeContainer staNodes, NodeContainer apNode)
+// function to update channel numbers, channel widths, GIs, MCSs, and Ptxs for each slice.
+// Tick i ends the control window opened by the previous tick, and schedules the next periodic tick T later.
+// With the SLA monitor, a tick is also run as soon as a slice breaks its SLA, and a periodic tick is skipped
+// (up to maxQuietTicks in a row) while every slice is well within its SLA: its window then extends to the next tick
+void update_channels (int i)
 {
-  std::cout << "At the beginning compute_channels is called" << std::endl;
+  controlEvent.Cancel ();
+  triggerEvent.Cancel ();
+  if (slaMonitor && !monitor.triggered && monitor.quietTicks < maxQuietTicks && sla_quiet ())
+  {
+    std::cout << "At time " << Simulator::Now ().GetSeconds () << "s update_channels is skipped" << std::endl;
+    monitor.quietTicks++;
+    // The rows of the tick are still written, with the configuration carried forward and the KPIs of the collector
+    std::vector<double> latency (station.nSta);
+    for (int sta = 0; sta < station.nSta; sta++)
+      latency[sta] = kpi.delaySum[sta] / kpi.rxPackets[sta];
+    write_tick (true, kpi.txPackets.data (), kpi.rxPackets.data (), latency.data ());
+    if (Simulator::Now () + Seconds (controlInterval) <= Seconds (simulationTime))
+      controlEvent = Simulator::Schedule (Seconds (controlInterval), &update_channels, i);
+    return;
+  }
+  std::cout << "At time " << Simulator::Now ().GetSeconds () << "s update_channels is called"
+            << (monitor.triggered ? " by the SLA monitor" : "") << std::endl;
+  controlTick = i;
+  lastControl = Simulator::Now ();
+
+  // Compute Inputs: rx power through the path loss [dB] (meaningful only when mobility is involved), # of tx packets, # of rx packets and latency
 
-  // Slice A
-  txPowerA = 20; // Maximum power
-  giA = 800; // Minimum GI
   for (int i = 0; i < nStaA; i++)
   {
-    rxPower[i] = txPowerA - lossModel->GetLoss (staNodes.Get(i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power A: " << rxPower[i] << std::endl;
+    station.rxPower[i] = txPowerA - lossCache.Get (i);
+    //std::cout << "Received power A: " << station.rxPower[i] << std::endl;
   }
-  double rxPowerA_min = 20;
-  for (int i = 0; i < nStaA; i++)
+  for (int i = 0; i < nStaB; i++)
   {
-    if (rxPower[i] < rxPowerA_min) rxPowerA_min = rxPower[i];
+    station.rxPower[nStaA+i] = txPowerB - lossCache.Get (nStaA+i);
+    //std::cout << "Received power B: " << station.rxPower[nStaA+i] << std::endl;
   }
-  // max MCS according to tab2
-  for (int i = 0; i < 12; i++)
+  for (int i = 0; i < nStaC; i++)
   {
-    if (tab2[i] > rxPowerA_min)
+    station.rxPower[nStaA+nStaB+i] = txPowerC - lossCache.Get (nStaA+nStaB+i);
+    //std::cout << "Received power C: " << station.rxPower[nStaA+nStaB+i] << std::endl;
+  }
+  read_stats();
+  if (verbose)
+  {
+    for (int i = 0; i < nStaA+nStaB+nStaC; i++)
     {
-      mcsA_max = i-2;
-      break;
+      std::cout << "Error Prob: " << station.ProbErr (0)[i] << std::endl;
     }
-    mcsA_max = 11;
   }
-  // min channelWidth according to tab1
-  if (dataRateSumA < tab1[mcsA_max][1])
+
+  // Compute Outputs: channel number, channel width, guard interval, mcs, tx power
+  take_snapshot (i);
+  if (pinConfig)
   {
-    channelWidthA = 20;
-    channelNumberA = 36;
+    // The configuration of the command line is kept
   }
-  else if (dataRateSumA < tab1[mcsA_max][3])
+  else if (asyncController)
+    request_decision (i); // applied later by apply_decision
+  else
   {
-    channelWidthA = 40;
-    channelNumberA = 38;
+    SliceConfig config[3];
+    get_config (config);
+    sliceController->Update (snapshot, config);
+    set_config (config);
   }
-  else if (dataRateSumA < tab1[mcsA_max][5])
+
+  // Set Outputs
+  apply_channels();
+
+  // Write file
+  write_tick (false, station.TxPackets (0), station.RxPackets (0), station.Latency (0));
+  if (binWriter.IsOpen ())
+    write_bin_chunk (BIN_UPDATE, i, Simulator::Now ().GetSeconds ());
+
+  // Next control tick, until the end of the traffic
+  if (slaMonitor)
   {
-    channelWidthA = 80;
-    channelNumberA = 42;
+    monitor.Reset ();
+    monitor.quietTicks = 0;
   }
-  else
+  if (Simulator::Now () + Seconds (controlInterval) <= Seconds (simulationTime))
+    controlEvent = Simulator::Schedule (Seconds (controlInterval), &update_channels, i + 1);
+}
+
+
+// function to compute channel numbers and widths for each slice
+void compute_channels (Ptr<BuildingsPropagationLossModel> lossModel,
+                      NodeContainer staNodes, NodeContainer apNode)
+{
+  std::cout << "At the beginning compute_channels is called" << std::endl;
+
+  // Compute Outputs: channel number, channel width, guard interval, mcs, tx power
+  initialize_controller();
+
+  // Set Outputs
+  apply_channels();
+
+  // Write file
+  std::ostream& out = writer.Buffer ();
+  out << "init_channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
+  out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
+  out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
+  out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
+  writer.Commit ();
+  if (binFileName != "")
+    write_bin_chunk (BIN_INIT, 0, Simulator::Now ().GetSeconds ());
+}
+
+
+// function to get the name of the output file of a variant: name with suffix before the extension
+std::string variant_file_name (std::string fileName, std::string suffix)
+{
+  std::size_t dot = fileName.find_last_of ('.');
+  if (dot == std::string::npos || fileName.find ('/', dot) != std::string::npos)
+    return fileName + suffix;
+  return fileName.substr (0, dot) + suffix + fileName.substr (dot);
+}
+
+
+// function to read the lines of a file of variants or candidates, without empty lines and comments
+std::vector<std::string> read_lines (std::string fileName)
+{
+  std::ifstream in (fileName.c_str ());
+  if (!in.good ())
   {
-    channelWidthA = 160;
-    channelNumberA = 50;
+    std::cout << ERROR << "Cannot read " << fileName << "!" << ENDC << std::endl;
+    std::exit (1);
   }
-  // min MCS allowed by channelWidthA from tab1
-  for (int i = 0; i < 12; i++)
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline (in, line))
   {
-    if (dataRateSumA < tab1[i][2* (int) log2(channelWidthA/10)-1])
-    {
-      mcsA_min = i;
-      break;
-    }
-    mcsA_min = 11;
+    std::size_t first = line.find_first_not_of (" \t");
+    if (first != std::string::npos && line[first] != '#')
+      lines.push_back (line);
   }
-  // min MCS
-  if (mcsA_max >= mcsA_min + 1) mcsA = mcsA_min + 1;
-  else mcsA = mcsA_max;
-  std::cout << "Slice A: " << channelWidthA << ", " << channelNumberA <<
-               ", " << giA << ", " << mcsA << ", " << txPowerA << std::endl;
-  std::cout << "Slice A mcs: " << mcsA_min << ", " << mcsA_max << std::endl;
+  return lines;
+}
 
-  // Slice B
-  channelWidthB = 20;
-  channelNumberB = 100;
-  giB = 1600;
-  // min MCS according to tab1
-  for (int i = 0; i < 12; i++)
+
+// Options which a variant or a screened candidate may override: the ones read after the start of the traffic
+const std::vector<std::string> overridableOptions = {
+  "channelNumberA", "channelWidthA", "mcsA", "giA", "txPowerA",
+  "channelNumberB", "channelWidthB", "mcsB", "giB", "txPowerB",
+  "channelNumberC", "channelWidthC", "mcsC", "giC", "txPowerC",
+  "controller", "controllerArgs", "pinConfig", "asyncController", "decisionDelay", "verbose",
+  "probErrMaxA", "probErrMaxB", "offMaxB", "probErrMaxC", "latencyMaxC",
+  "slaMargin", "maxQuietTicks", "monitorMinPackets", "triggerHoldoff"
+};
+
+
+// function to check that every override of a line (name=value ...) sets one of the overridable options,
+// since the others (topology, traffic, ...) have already been used
+void check_overrides (std::string line)
+{
+  std::istringstream tokens (line);
+  std::string token;
+  while (tokens >> token)
   {
-  	if (tab1[i][0] > dataRateSumB/1000)
+    std::string name = token.substr (0, token.find ('='));
+    if (std::find (overridableOptions.begin (), overridableOptions.end (), name) == overridableOptions.end ())
     {
-      mcsB = i+1;
-      break;
+      std::cout << ERROR << "Option " << name << " cannot be overridden (" << line << ")!" << ENDC << std::endl;
+      std::exit (1);
     }
-    mcsB = 11;
-  }
-  // min txPower according to tab2
-  std::vector<double> lossB(nStaB);
-  for (int i = 0; i < nStaB; i++)
-  {
-  	lossB[i] = lossModel->GetLoss (staNodes.Get(nStaA+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
   }
-  sort(lossB.begin(), lossB.end());
-  txPowerB = lossB[nStaB - nStaB/10 - 1] + tab2[mcsB] + 3;
-  std::cout << "Slice B: " << channelWidthB << ", " << channelNumberB <<
-               ", " << giB << ", " << mcsB << ", " << txPowerB << std::endl;
+}
 
-  // Slice C
-  txPowerC = 20; // Maximum power
-  giC = 800; // Minimum GI
-  for (int i = 0; i < nStaC; i++)
-  {
-    rxPower[nStaA+nStaB+i] = txPowerC - lossModel->GetLoss (staNodes.Get(nStaA+nStaB+i)->GetObject<MobilityModel> (), apNode.Get(0)->GetObject<MobilityModel> ());
-    //std::cout << "Received power C: " << rxPower[nStaA+nStaB+i] << std::endl;
-  }
-  double rxPowerC_min = 20;
-  for (int i = 0; i < nStaC; i++)
-  {
-  	if (rxPower[nStaA+nStaB+i] < rxPowerC_min) rxPowerC_min = rxPower[nStaA+nStaB+i];
-  }
-  // max MCS according to tab2
-  for (int i = 0; i < 12; i++)
+
+// function to re-parse the command line with the overrides of one line (name=value ...)
+void configure_overrides (std::string line)
+{
+  check_overrides (line);
+  std::istringstream tokens (line);
+  std::vector<std::string> args (1, "overrides");
+  std::string token;
+  while (tokens >> token)
+    args.push_back ("--" + token);
+  std::vector<char*> argv;
+  for (std::size_t j = 0; j < args.size (); j++)
+    argv.push_back (&args[j][0]);
+  configure (argv.size (), argv.data ());
+}
+
+
+// function to start the variants listed in variantFile, called when the traffic starts.
+// Topology, association and initial channels are shared: the process forks once per variant and
+// each child re-parses the command line with the overrides of its line (name=value ...), applies the
+// slice configuration and runs the rest of the simulation, writing to <csvFileName>_v<k>.
+// Only the options read after the start of the traffic (overridableOptions) can be overridden;
+// a variant selecting another controller (controller, controllerArgs) starts from the configuration of its Initialize.
+// The parent waits for the variants (up to jobs at the same time) and exits
+void warm_start()
+{
+  std::vector<std::string> variants = read_lines (variantFile);
+  for (std::size_t k = 0; k < variants.size (); k++)
+    check_overrides (variants[k]);
+  std::cout << OKBLUE << "Warm start at " << Simulator::Now ().GetSeconds () << "s: "
+            << variants.size () << " variant(s)" << ENDC << std::endl;
+
+  int running = 0, failed = 0;
+  for (int k = 1; k <= (int) variants.size (); k++)
   {
-  	if (tab2[i] > rxPowerC_min)
+    if (running == std::max (jobs, 1))
     {
-      mcsC_max = i-2;
-      break;
+      failed += wait_seed();
+      running--;
     }
-    mcsC_max = 11;
-  }
-  // min channelWidth according to tab1
-  if (dataRateSumC < tab1[mcsC_max][1])
-  {
-    channelWidthC = 20;
-    channelNumberC = 161;
-  }
-  else if (dataRateSumC < tab1[mcsC_max][3])
-  {
-    channelWidthC = 40;
-    channelNumberC = 159;
-  }
-  else if (dataRateSumC < tab1[mcsC_max][5])
-  {
-    channelWidthC = 80;
-    channelNumberC = 155;
-  }
-  else
-  {
-    channelWidthC = 160;
-    channelNumberC = 144;
-  }
-  // min MCS allowed by channelWidthC from tab1
-  for (int i = 0; i < 12; i++)
-  {
-    if (dataRateSumC < tab1[i][2* (int) log2(channelWidthC/10)-1])
+    pid_t pid = fork ();
+    if (pid < 0)
     {
-      mcsC_min = i;
+      std::cout << ERROR << "Cannot fork variant " << k << "!" << ENDC << std::endl;
+      failed++;
       break;
     }
-    mcsC_min = 11;
+    if (pid == 0)
+    {
+      std::string parentLibrary = controllerLibrary, parentArgs = controllerArgs;
+      configure_overrides (variants[k-1]);
+      std::cout << OKBLUE << "Variant " << k << ": " << variants[k-1] << ENDC << std::endl;
+      if (controllerLibrary != parentLibrary || controllerArgs != parentArgs)
+      {
+        if (!load_controller())
+          std::exit (1);
+        initialize_controller();
+      }
+      if (pinConfig)
+      {
+        SliceConfig config[3];
+        get_config (config);
+        pin_channel_numbers (config);
+        set_config (config);
+      }
+
+      // Output files of the variant
+      std::string suffix = "_v" + std::to_string (k);
+      set_journal_file_name();
+      csvFileName = variant_file_name (csvFileName, suffix);
+      journalFileName = variant_file_name (journalFileName, suffix);
+      writer.Open (csvFileName, asyncWriter);
+      if (binFileName != "")
+      {
+        binFileName = variant_file_name (binFileName, suffix);
+        binWriter.Open (binFileName, asyncWriter);
+      }
+      apply_channels();
+      return;
+    }
+    running++;
   }
-  // MCS
-  if (mcsC_max >= mcsC_min + 1) mcsC = mcsC_max;
-  else mcsC = mcsC_min + 1;
-  std::cout << "Slice C: " << channelWidthC << ", " << channelNumberC <<
-               ", " << giC << ", " << mcsC << ", " << txPowerC << std::endl;
-  std::cout << "Slice C mcs: " << mcsC_min << ", " << mcsC_max << std::endl;
+  for (; running > 0; running--)
+    failed += wait_seed();
+  std::exit (failed > 0);
+}
 
-  // Set Outputs
-  set_channel_number();
-  set_channel_width();
-  set_tx_power();
-  set_guard_interval();
-  set_mcs();
 
-  // Write file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
-  out << "init_channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
-  out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
-  out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
-  out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
-  out.close ();
+// Candidate configuration ranked by screen
+struct Candidate
+{
+  int line;                   // line of the candidate in screenFileName (from 1)
+  int slaMet;                 // # of slices meeting their SLA
+  int spectrum;               // total channel width [MHz]
+  int txPowerB;               // dBm
+  SliceEstimate estimate[3];
+};
+
+
+// function to compare two candidates: more slices meeting their SLA, then less spectrum, then lower txPowerB
+bool better_candidate (const Candidate& a, const Candidate& b)
+{
+  if (a.slaMet != b.slaMet)
+    return a.slaMet > b.slaMet;
+  if (a.spectrum != b.spectrum)
+    return a.spectrum < b.spectrum;
+  if (a.txPowerB != b.txPowerB)
+    return a.txPowerB < b.txPowerB;
+  return a.line < b.line;
+}
+
+
+// function to rank the candidate configurations of screenFileName with the analytical estimator, without simulating them.
+// Each line overrides the configuration computed by compute_channels (name=value ...); the stations, their data rates
+// and positions are those of the seed, so only the overridable options (slice configuration, SLA options, ...) can be set.
+// The ranking is written to csvFileName, one row per candidate, instead of the rows of the simulation.
+void screen()
+{
+  std::vector<std::string> lines = read_lines (screenFileName);
+  std::cout << OKBLUE << "Screening " << lines.size () << " candidate(s) of " << screenFileName << ENDC << std::endl;
+  SliceConfig baseline[3];
+  get_config (baseline);
+  std::vector<Candidate> candidates (lines.size ());
+  for (std::size_t k = 0; k < lines.size (); k++)
+  {
+    set_config (baseline);
+    configure_overrides (lines[k]);
+    SliceConfig config[3];
+    get_config (config);
+    if (pinConfig)
+      pin_channel_numbers (config);
+    Candidate& candidate = candidates[k];
+    candidate.line = k + 1;
+    for (int s = 0; s < 3; s++)
+      candidate.estimate[s] = estimate_slice (s, config[s]);
+    candidate.slaMet = (candidate.estimate[0].probErr <= probErrMaxA)
+                       + (candidate.estimate[1].probErr <= probErrMaxB)
+                       + (candidate.estimate[2].probErr <= probErrMaxC && candidate.estimate[2].delay <= latencyMaxC * 1000);
+    candidate.spectrum = config[0].channelWidth + config[1].channelWidth + config[2].channelWidth;
+    candidate.txPowerB = config[1].txPower;
+  }
+  std::sort (candidates.begin (), candidates.end (), better_candidate);
+
+  ResultWriter ranking;
+  ranking.Open (csvFileName, false);
+  std::ostream& out = ranking.Buffer ();
+  out << "rank, line, slaMet, spectrum, txPowerB, throughputA, probErrA, delayA, throughputB, probErrB, delayB, "
+      << "throughputC, probErrC, delayC" << std::endl;
+  for (std::size_t k = 0; k < candidates.size (); k++)
+  {
+    out << k + 1 << "," << candidates[k].line << "," << candidates[k].slaMet << ","
+        << candidates[k].spectrum << "," << candidates[k].txPowerB;
+    for (int s = 0; s < 3; s++)
+      out << "," << candidates[k].estimate[s].throughput << "," << candidates[k].estimate[s].probErr
+          << "," << candidates[k].estimate[s].delay;
+    out << std::endl;
+  }
+  ranking.Close ();
 }
 
 
@@ -879,14 +2036,41 @@ int main (int argc, char *argv[])
 {
   // Define CMD commands
   configure(argc, argv);
+  if (lastSeed > seed || keepShards)
+  {
+    set_journal_file_name();
+    std::vector<SeedOutput> outputs = {{&csvFileName, 0},
+                                       {&journalFileName, journalHeader.size () + 1},
+                                       {&binFileName, BinWriter::HeaderSize ()}};
+    int failed = fork_seeds (seed, lastSeed, jobs, keepShards, outputs);
+    if (failed >= 0)
+      return failed > 0;
+  }
+  allocate_stations();
+  if (!load_controller())
+    return 1;
+  if (phyModel == "abstract")
+    kpiSource = "trace"; // the abstract PHY feeds the KPI collector
+  if (slaMonitor)
+    kpiSource = "trace"; // the SLA monitor is fed by the packet traces
+  // With variants the files are opened by each variant, after the warm start, and screening writes only its ranking
+  if (variantFile == "" && screenFileName == "")
+    writer.Open (csvFileName, asyncWriter);
+  if (binFileName != "")
+  {
+    if (runId == 0)
+      runId = seed;
+    if (variantFile == "" && screenFileName == "")
+      binWriter.Open (binFileName, asyncWriter);
+  }
 
   // Set the PRNG seed
   RngSeedManager::SetSeed (seed);
 
   // Set random throughput for each flow in the the 3 slices
   Ptr<UniformRandomVariable> dataRateA_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateA_ptr->SetAttribute ("Min", DoubleValue (80));
-  dataRateA_ptr->SetAttribute ("Max", DoubleValue (101));
+  dataRateA_ptr->SetAttribute ("Min", DoubleValue (dataRateMinA));
+  dataRateA_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxA));
   std::vector<std::string> dataRateA_str(nStaA);
   for (int i = 0; i < nStaA; i++)
   {
@@ -894,8 +2078,8 @@ int main (int argc, char *argv[])
     dataRateA_str[i] = std::to_string(dataRateA[i]) + "Mb/s";
   }
   Ptr<UniformRandomVariable> dataRateB_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateB_ptr->SetAttribute ("Min", DoubleValue (30));
-  dataRateB_ptr->SetAttribute ("Max", DoubleValue (51));
+  dataRateB_ptr->SetAttribute ("Min", DoubleValue (dataRateMinB));
+  dataRateB_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxB));
   std::vector<std::string> dataRateB_str(nStaB);
   for (int i = 0; i < nStaB; i++)
   {
@@ -903,8 +2087,8 @@ int main (int argc, char *argv[])
     dataRateB_str[i] = std::to_string(dataRateB[i]) + "Kb/s";
   }
   Ptr<UniformRandomVariable> dataRateC_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateC_ptr->SetAttribute ("Min", DoubleValue (20));
-  dataRateC_ptr->SetAttribute ("Max", DoubleValue (41));
+  dataRateC_ptr->SetAttribute ("Min", DoubleValue (dataRateMinC));
+  dataRateC_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxC));
   std::vector<std::string> dataRateC_str(nStaC);
   for (int i = 0; i < nStaC; i++)
   {
@@ -921,8 +2105,8 @@ int main (int argc, char *argv[])
   y_ptr->SetAttribute ("Max", DoubleValue (y_max));
   for (int i = 0; i < nStaA+nStaB+nStaC; i++)
   {
-    x[i] = x_ptr->GetValue ();
-    y[i] = y_ptr->GetValue ();
+    station.x[i] = x_ptr->GetValue ();
+    station.y[i] = y_ptr->GetValue ();
   }
 
   // Compute Channels according to initialization algorithm
@@ -942,17 +2126,45 @@ int main (int argc, char *argv[])
   // Create a phy helper
   SpectrumWifiPhyHelper spectrumPhy = SpectrumWifiPhyHelper::Default ();
   YansWifiPhyHelper yansPhy = YansWifiPhyHelper::Default ();
-  Ptr<HybridBuildingsPropagationLossModel> lossModel = CreateObject<HybridBuildingsPropagationLossModel> ();
+  Ptr<BuildingsPropagationLossModel> lossModel = CreateObject<HybridBuildingsPropagationLossModel> ();
+  Ptr<BuildingsPropagationLossModel> exactLossModel = lossModel;
+  Ptr<GridBuildingsPropagationLossModel> gridLossModel;
+  if (gridStep > 0)
+  {
+    gridLossModel = CreateObject<GridBuildingsPropagationLossModel> ();
+    lossModel = gridLossModel;
+  }
+  
+  Ptr<MultiModelSpectrumChannel> sliceChannel[3];
+  if (controlInterval <= 0)
+  {
+    std::cout << "Wrong controlInterval value!" << std::endl;
+    return 0;
+  }
+  if (asyncController && asyncPollStep <= 0)
+  {
+    std::cout << "Wrong asyncPollStep value!" << std::endl;
+    return 0;
+  }
+  if (errorModel != "nist" && errorModel != "table")
+  {
+    std::cout << "Wrong errorModel value!" << std::endl;
+    return 0;
+  }
+  TableErrorRateModel::SetPayloadSize (payloadSize);
   
   if (phyModel == "spectrum")
   {
-  	// Create the channel
-  	Ptr<MultiModelSpectrumChannel> channel = CreateObject<MultiModelSpectrumChannel> ();
-  	channel->AddPropagationLossModel (lossModel);
+  	// Create the channel, or one channel per slice sharing the same loss and delay models
   	Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
-  	channel->SetPropagationDelayModel (delayModel);
-  	spectrumPhy.SetErrorRateModel ("ns3::NistErrorRateModel");
-  	spectrumPhy.SetChannel (channel);
+  	for (int s = 0; s < (channelPerSlice ? 3 : 1); s++)
+  	{
+  	  sliceChannel[s] = CreateObject<MultiModelSpectrumChannel> ();
+  	  sliceChannel[s]->AddPropagationLossModel (lossModel);
+  	  sliceChannel[s]->SetPropagationDelayModel (delayModel);
+  	}
+  	spectrumPhy.SetErrorRateModel (errorModel == "table" ? "TableErrorRateModel" : "ns3::NistErrorRateModel");
+  	spectrumPhy.SetChannel (sliceChannel[0]);
   	//spectrumPhy.Set ("TxPowerStart", DoubleValue (txPower));
   	//spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPower));
   }
@@ -961,9 +2173,15 @@ int main (int argc, char *argv[])
     // Create the channel
     YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
     yansPhy.SetChannel (channel.Create ());
+    if (errorModel == "table")
+      yansPhy.SetErrorRateModel ("TableErrorRateModel");
   	//yansPhy.Set ("TxPowerStart", DoubleValue (txPower));
   	//yansPhy.Set ("TxPowerEnd", DoubleValue (txPower));
   }
+  else if (phyModel == "abstract")
+  {
+    // No channel: the medium of each slice is modelled by abstract_step
+  }
   else
   {
     std::cout << "Wrong phyModel value!" << std::endl;
@@ -1059,6 +2277,8 @@ int main (int argc, char *argv[])
 
   	// Network B
   	ssid = Ssid ("networkB");
+  	if (channelPerSlice)
+  	  spectrumPhy.SetChannel (sliceChannel[1]);
   	spectrumPhy.Set ("ChannelNumber", UintegerValue (channelNumberB));
     spectrumPhy.Set ("TxPowerStart", DoubleValue (txPowerB));
     spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPowerB));
@@ -1072,6 +2292,8 @@ int main (int argc, char *argv[])
 
     // Network C
     ssid = Ssid ("networkC");
+    if (channelPerSlice)
+      spectrumPhy.SetChannel (sliceChannel[2]);
     spectrumPhy.Set ("ChannelNumber", UintegerValue (channelNumberC));
     spectrumPhy.Set ("TxPowerStart", DoubleValue (txPowerC));
     spectrumPhy.Set ("TxPowerEnd", DoubleValue (txPowerC));
@@ -1124,15 +2346,19 @@ int main (int argc, char *argv[])
                  "Ssid", SsidValue (ssid));
     apDeviceC = wifi.Install (yansPhy, mac, apNode.Get(0));
   }
-  else
+  else if (phyModel != "abstract")
   {
     std::cout << "Wrong phyModel value!" << std::endl;
     return 0;
   }
 
+  if (phyModel != "abstract")
+    build_slice_registry (staDeviceA, apDeviceA, staDeviceB, apDeviceB, staDeviceC, apDeviceC);
+
   set_channel_width();
   set_guard_interval();
   set_mcs();
+  store_applied_config();
 
   // Set RTS-CTS
   Config::Set ("/NodeList/*/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/RtsCtsThreshold",
@@ -1153,7 +2379,7 @@ int main (int argc, char *argv[])
   positionAlloc->Add (Vector (10.0, 5.0, 2.9));
   // Set position for STAs
   for (int i = 0; i < nStaA+nStaB+nStaC; i++)
-    positionAlloc->Add (Vector (x[i], y[i], 1.5));
+    positionAlloc->Add (Vector (station.x[i], station.y[i], 1.5));
   MobilityHelper mobility;
   mobility.SetPositionAllocator (positionAlloc);
   mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
@@ -1173,128 +2399,135 @@ int main (int argc, char *argv[])
   BuildingsHelper::Install (staNodes);
   BuildingsHelper::MakeMobilityModelConsistent ();
 
+  if (gridStep > 0)
+  {
+    gridLossModel->Build (exactLossModel, apNode.Get (0)->GetObject<MobilityModel> (), x_max, y_max, 1.5, gridStep, gridFileName);
+    std::cout << OKBLUE << "Path loss grid: max interpolation error " << gridLossModel->GetMaxError () << " dB" << ENDC << std::endl;
+  }
+  lossCache.Init (lossModel, staNodes, apNode);
   compute_channels (lossModel, staNodes, apNode);
+  if (screenFileName != "")
+  {
+    screen();
+    return 0;
+  }
 
-  // Internet stack
-  InternetStackHelper stack;
-  stack.Install (apNode);
-  stack.Install (staNodes);
+  if (phyModel == "abstract")
+  {
+    abstractUniform = CreateObject<UniformRandomVariable> ();
+    abstractNormal = CreateObject<NormalRandomVariable> ();
+    abstractCredit.assign (nStaA + nStaB + nStaC, 0);
+    if (abstractStep > controlInterval)
+      std::cout << WARNING << "abstractStep is longer than controlInterval: some control windows see no traffic!" << ENDC << std::endl;
+    Simulator::Schedule (Seconds (1.0), &abstract_step);
+  }
+  else
+  {
+    // Internet stack
+    InternetStackHelper stack;
+    stack.Install (apNode);
+    stack.Install (staNodes);
 
-  Ipv4AddressHelper address;
-  address.SetBase ("192.168.1.0", "255.255.255.0");
-  std::vector<Ipv4InterfaceContainer> staInterfaceA(nStaA);
-  for (int i = 0; i < nStaA; i++)
-    staInterfaceA[i] = address.Assign (staDeviceA[i]);
-  Ipv4InterfaceContainer apInterfaceA = address.Assign (apDeviceA);
+    Ipv4AddressHelper address;
+    address.SetBase ("10.1.0.0", "255.255.0.0");
+    std::vector<Ipv4InterfaceContainer> staInterfaceA(nStaA);
+    for (int i = 0; i < nStaA; i++)
+      staInterfaceA[i] = address.Assign (staDeviceA[i]);
+    Ipv4InterfaceContainer apInterfaceA = address.Assign (apDeviceA);
 
-  address.SetBase ("192.168.2.0", "255.255.255.0");
-  std::vector<Ipv4InterfaceContainer> staInterfaceB(nStaB);
-  for (int i = 0; i < nStaB; i++)
-    staInterfaceB[i] = address.Assign (staDeviceB[i]);
-  Ipv4InterfaceContainer apInterfaceB = address.Assign (apDeviceB);
+    address.SetBase ("10.2.0.0", "255.255.0.0");
+    std::vector<Ipv4InterfaceContainer> staInterfaceB(nStaB);
+    for (int i = 0; i < nStaB; i++)
+      staInterfaceB[i] = address.Assign (staDeviceB[i]);
+    Ipv4InterfaceContainer apInterfaceB = address.Assign (apDeviceB);
 
-  address.SetBase ("192.168.3.0", "255.255.255.0");
-  std::vector<Ipv4InterfaceContainer> staInterfaceC(nStaC);
-  for (int i = 0; i < nStaC; i++)
-    staInterfaceC[i] = address.Assign (staDeviceC[i]);
-  Ipv4InterfaceContainer apInterfaceC = address.Assign (apDeviceC);
+    address.SetBase ("10.3.0.0", "255.255.0.0");
+    std::vector<Ipv4InterfaceContainer> staInterfaceC(nStaC);
+    for (int i = 0; i < nStaC; i++)
+      staInterfaceC[i] = address.Assign (staDeviceC[i]);
+    Ipv4InterfaceContainer apInterfaceC = address.Assign (apDeviceC);
 
-  // Flow monitor
-  flowMonitor = flowHelper.InstallAll();
+    // Flow monitor
+    if (kpiSource == "flowMonitor")
+      flowMonitor = flowHelper.InstallAll();
+    else if (kpiSource != "trace")
+    {
+      std::cout << "Wrong kpiSource value!" << std::endl;
+      return 0;
+    }
 
-  // Setting applications
-  uint16_t index = 1;
-  std::vector<ApplicationContainer> clientAppA(nStaA), serverAppA(nStaA);
-  std::vector<ApplicationContainer> clientAppB(nStaB), serverAppB(nStaB);
-  std::vector<ApplicationContainer> clientAppC(nStaC), serverAppC(nStaC);
+    // Setting applications
+    uint16_t index = 1;
+    std::vector<ApplicationContainer> clientAppA(nStaA), serverAppA(nStaA);
+    std::vector<ApplicationContainer> clientAppB(nStaB), serverAppB(nStaB);
+    std::vector<ApplicationContainer> clientAppC(nStaC), serverAppC(nStaC);
 
-  for (int i = 0; i < nStaA; i++)
-    new_application (index, staNodes, apNode, dataRateA_str[i], apInterfaceA, clientAppA[i], serverAppA[i]);
+    for (int i = 0; i < nStaA; i++)
+      new_application (index, staNodes, apNode, dataRateA_str[i], apInterfaceA, clientAppA[i], serverAppA[i]);
 
-  for (int i = 0; i < nStaB; i++)
-    new_application (index, staNodes, apNode, dataRateB_str[i], apInterfaceB, clientAppB[i], serverAppB[i]);
+    for (int i = 0; i < nStaB; i++)
+      new_application (index, staNodes, apNode, dataRateB_str[i], apInterfaceB, clientAppB[i], serverAppB[i]);
 
-  for (int i = 0; i < nStaC; i++)
-    new_application (index, staNodes, apNode, dataRateC_str[i], apInterfaceC, clientAppC[i], serverAppC[i]);
+    for (int i = 0; i < nStaC; i++)
+      new_application (index, staNodes, apNode, dataRateC_str[i], apInterfaceC, clientAppC[i], serverAppC[i]);
 
-  if (enablePcap)
-  {
-  	if (phyModel == "spectrum")
-  	{
-  		spectrumPhy.EnablePcap ("AP_A", apDeviceA.Get (0));
-  		spectrumPhy.EnablePcap ("STA_A", staDeviceA[0].Get (0));
-  		spectrumPhy.EnablePcap ("AP_B", apDeviceB.Get (0));
-  		spectrumPhy.EnablePcap ("STA_B", staDeviceB[0].Get (0));
-  		spectrumPhy.EnablePcap ("AP_C", apDeviceC.Get (0));
-  		spectrumPhy.EnablePcap ("STA_C", staDeviceC[0].Get (0));
-  	}
-  	else if (phyModel == "yans")
-  	{
-  		yansPhy.EnablePcap ("AP_A", apDeviceA.Get (0));
-  		yansPhy.EnablePcap ("STA_A", staDeviceA[0].Get (0));
-  		yansPhy.EnablePcap ("AP_B", apDeviceB.Get (0));
-  		yansPhy.EnablePcap ("STA_B", staDeviceB[0].Get (0));
-  		yansPhy.EnablePcap ("AP_C", apDeviceC.Get (0));
-  		yansPhy.EnablePcap ("STA_C", staDeviceC[0].Get (0));
-  	}
-  	else
-  	{
-  		std::cout << "Wrong phyModel value!" << std::endl;
-  		return 0;
-  	}
+    if (enablePcap)
+    {
+    	if (phyModel == "spectrum")
+    	{
+    		spectrumPhy.EnablePcap ("AP_A", apDeviceA.Get (0));
+    		spectrumPhy.EnablePcap ("STA_A", staDeviceA[0].Get (0));
+    		spectrumPhy.EnablePcap ("AP_B", apDeviceB.Get (0));
+    		spectrumPhy.EnablePcap ("STA_B", staDeviceB[0].Get (0));
+    		spectrumPhy.EnablePcap ("AP_C", apDeviceC.Get (0));
+    		spectrumPhy.EnablePcap ("STA_C", staDeviceC[0].Get (0));
+    	}
+    	else if (phyModel == "yans")
+    	{
+    		yansPhy.EnablePcap ("AP_A", apDeviceA.Get (0));
+    		yansPhy.EnablePcap ("STA_A", staDeviceA[0].Get (0));
+    		yansPhy.EnablePcap ("AP_B", apDeviceB.Get (0));
+    		yansPhy.EnablePcap ("STA_B", staDeviceB[0].Get (0));
+    		yansPhy.EnablePcap ("AP_C", apDeviceC.Get (0));
+    		yansPhy.EnablePcap ("STA_C", staDeviceC[0].Get (0));
+    	}
+    	else
+    	{
+    		std::cout << "Wrong phyModel value!" << std::endl;
+    		return 0;
+    	}
+    }
   }
 
   Simulator::Stop (Seconds (simulationTime + 2));
 
-  for (int i = 2; i < simulationTime +1; i++)
-  {
-    Simulator::Schedule(Seconds(i), &update_channels,
-                        i, lossModel, staNodes, apNode);
-  }
+  if (variantFile != "")
+    Simulator::Schedule (Seconds (1.0), &warm_start);
+
+  if (1 + controlInterval <= simulationTime + 1e-9)
+    controlEvent = Simulator::Schedule (Seconds (1 + controlInterval), &update_channels, 2);
 
   time_t timeNow = time(0);
   char* ctimeNow =ctime(&timeNow);
   std::cout << OKBLUE <<"Simulation started!  Time: " << ctimeNow << ENDC;
 
   Simulator::Run ();
+  if (decision.thread.joinable ())
+    decision.Join (); // decision still pending at the end of the simulation
+  if (errorModel == "table")
+    std::cout << OKBLUE << "Error rate tables: max success rate error " << TableErrorRateModel::GetMaxError ()
+              << " (" << payloadSize << " bytes)" << ENDC << std::endl;
 
   // Activate/deactivate the histograms and the per-probe detailed stats
-  std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
-  flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
-
-  // Show results
-  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
-  FlowMonitor::FlowStatsContainer stats = flowMonitor->GetFlowStats ();
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
-  {
-    txPackets_unsort[i->first-1] = i->second.txPackets;
-    rxPackets_unsort[i->first-1] = i->second.rxPackets;
-    latency_unsort[i->first-1] = i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets;
-    Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-    destPorts[i->first-1] = t.destinationPort;
-    //std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << "," << destPorts[i->first-1] << ")\n";
-    //std::cout << "  Tx Packets: " << totTxPackets[i->first-1] << "\n";
-    //std::cout << "  Rx Packets: " << totRxPackets[i->first-1] << "\n";
-    //std::cout << "  Delay Sum: " << totDelay[i->first-1] << "\n";
-    //std::cout << "  Delay Sum MS: " << i->second.delaySum.ToDouble(Time::MS) << "\n";
-    //std::cout << "  Delay: " << i->second.delaySum / i->second.rxPackets << "\n";
-    //std::cout << "  Delay MS: " << i->second.delaySum.ToDouble(Time::MS) / i->second.rxPackets << "\n";
-  }
-  // Shift txPackets, rxPackets and latency
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
+  if (kpiSource == "flowMonitor" && jobs == 1 && variantFile == "") // parallel runs would overwrite each other's file
   {
-  	txPackets[1][i] = txPackets[0][i];
-  	rxPackets[1][i] = rxPackets[0][i];
-  	latency[1][i] = latency[0][i];
-  }
-  // Compute txPackets, rxPackets and latency
-  for (int i = 0; i < nStaA+nStaB+nStaC; i++)
-  {
-    txPackets[0][destPorts[i]-5001] = txPackets_unsort[i];
-    rxPackets[0][destPorts[i]-5001] = rxPackets_unsort[i];
-    latency[0][destPorts[i]-5001] = latency_unsort[i];
+    std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
+    flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
   }
 
+  // Show results
+  read_stats();
+
   timeNow = time(0);
   ctimeNow =ctime(&timeNow);
   std::cout << OKBLUE << "Simulation finished! Time: " << ctimeNow << ENDC;
@@ -1302,29 +2535,36 @@ int main (int argc, char *argv[])
 
   // Write file csvFileName.csv
   std::cout << OKBLUE <<"Writing to file: " << csvFileName << ENDC << std::endl;
-  // std::ofstream out (csvFileName.c_str ()); // Use it to overwrite the file
-  std::ofstream out (csvFileName.c_str (), std::ios::app);
+  std::ostream& out = writer.Buffer ();
   out << "fin_channelNumber, channelWidth, gi, mcs, txPower" << std::endl;
   out << channelNumberA << "," << channelWidthA << "," << giA << "," << mcsA << "," << txPowerA << std::endl;
   out << channelNumberB << "," << channelWidthB << "," << giB << "," << mcsB << "," << txPowerB << std::endl;
   out << channelNumberC << "," << channelWidthC << "," << giC << "," << mcsC << "," << txPowerC << std::endl;
   for (int i = 0; i < nStaA; i++)
   {
-    out << dataRateA[i] << "," << x[i] << "," << y[i] << ","
-    << txPackets[0][i] << "," << rxPackets[0][i] << "," << latency[0][i]
+    out << dataRateA[i] << "," << station.x[i] << "," << station.y[i] << ","
+    << station.TxPackets (0)[i] << "," << station.RxPackets (0)[i] << "," << station.Latency (0)[i]
     << std::endl;
   }
   for (int i = 0; i < nStaB; i++)
   {
-    out << dataRateB[i] << "," << x[nStaA+i] << "," << y[nStaA+i] << ","
-    << txPackets[0][nStaA+i] << "," << rxPackets[0][nStaA+i] << "," << latency[0][nStaA+i] << std::endl;
+    out << dataRateB[i] << "," << station.x[nStaA+i] << "," << station.y[nStaA+i] << ","
+    << station.TxPackets (0)[nStaA+i] << "," << station.RxPackets (0)[nStaA+i] << "," << station.Latency (0)[nStaA+i] << std::endl;
   }
   for (int i = 0; i < nStaC; i++)
   {
-    out << dataRateC[i] << "," << x[nStaA+nStaB+i] << "," << y[nStaA+nStaB+i] << ","
-    << txPackets[0][nStaA+nStaB+i] << "," << rxPackets[0][nStaA+nStaB+i] << "," << latency[0][nStaA+nStaB+i] << std::endl;
+    out << dataRateC[i] << "," << station.x[nStaA+nStaB+i] << "," << station.y[nStaA+nStaB+i] << ","
+    << station.TxPackets (0)[nStaA+nStaB+i] << "," << station.RxPackets (0)[nStaA+nStaB+i] << "," << station.Latency (0)[nStaA+nStaB+i] << std::endl;
   }
-  out.close ();
+  writer.Close ();
+  if (binWriter.IsOpen ())
+  {
+    write_bin_chunk (BIN_FINAL, controlTick + 1, simulationTime + 2);
+    binWriter.Close ();
+  }
+  write_journal();
+  delete sliceController; // the controller releases its resources (e.g. the shared memory of shm_controller)
+  sliceController = 0;
 
   return 0;
 }
\ No newline at end of file
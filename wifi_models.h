@@ -0,0 +1,288 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ *
+ * Author: Matteo Nerini
+ * Email:  m.nerini20@imperial.ac.uk
+ * Date:   June 2020
+ *
+ *
+ * Models shared by the ns-3 scripts which serve the PHY faster than the exact ns-3 models:
+ *
+ *   TableErrorRateModel                 NistErrorRateModel served from tables (errorModel=table)
+ *   GridBuildingsPropagationLossModel   path loss to the AP interpolated on a grid (gridStep, gridFileName)
+ *
+ * Each script is a single translation unit, so the models are defined here, as slice_controller.h does.
+ *
+ */
+
+#ifndef WIFI_MODELS_H
+#define WIFI_MODELS_H
+
+#include "ns3/error-rate-model.h"
+#include "ns3/nist-error-rate-model.h"
+#include "ns3/buildings-module.h"
+#include "ns3/constant-position-mobility-model.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Error rate model serving the chunk success rates of NistErrorRateModel from tables. The first time a mode is
+// used, the bit error probability pe of the Nist model is tabulated against the SNR [dB]; a chunk of nbits bits then
+// succeeds with probability (1 - pe)^nbits, as in the Nist model, so neither the channel width (already in the SNR)
+// nor the payload size needs a table of its own. SNRs outside the tables use the Nist model.
+class TableErrorRateModel : public ErrorRateModel
+{
+public:
+  static TypeId GetTypeId (void);
+  TableErrorRateModel ();
+  static double GetMaxError () { return s_maxError; }
+  static void SetPayloadSize (uint32_t bytes) { s_payloadSize = bytes; }
+
+private:
+  virtual double DoGetChunkSuccessRate (WifiMode mode, WifiTxVector txVector, double snr, uint64_t nbits) const;
+  const std::vector<double>& GetTable (WifiMode mode, WifiTxVector txVector) const;
+
+  Ptr<NistErrorRateModel> m_nist;
+  static const double s_snrMin, s_snrMax, s_snrStep;       // SNR range and step of the tables [dB]
+  static std::vector<std::vector<double> > s_tables;       // log(pe) per mode uid, shared by every PHY
+  static double s_maxError;                                // max error on the success rate of a s_payloadSize frame
+  static uint32_t s_payloadSize;                           // bytes of the frames the max error is computed for
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TableErrorRateModel);
+
+const double TableErrorRateModel::s_snrMin = -10;
+const double TableErrorRateModel::s_snrMax = 60;
+const double TableErrorRateModel::s_snrStep = 0.05;
+std::vector<std::vector<double> > TableErrorRateModel::s_tables;
+double TableErrorRateModel::s_maxError = 0;
+uint32_t TableErrorRateModel::s_payloadSize = 1472;
+
+TypeId TableErrorRateModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("TableErrorRateModel")
+    .SetParent<ErrorRateModel> ()
+    .AddConstructor<TableErrorRateModel> ();
+  return tid;
+}
+
+TableErrorRateModel::TableErrorRateModel ()
+  : m_nist (CreateObject<NistErrorRateModel> ())
+{
+}
+
+// function to get the table of mode, filling it from the Nist model the first time the mode is used
+const std::vector<double>& TableErrorRateModel::GetTable (WifiMode mode, WifiTxVector txVector) const
+{
+  if (s_tables.size () <= mode.GetUid ())
+    s_tables.resize (mode.GetUid () + 1);
+  std::vector<double>& table = s_tables[mode.GetUid ()];
+  if (!table.empty ())
+    return table;
+
+  int n = (int) std::round ((s_snrMax - s_snrMin) / s_snrStep) + 1;
+  table.resize (n);
+  for (int k = 0; k < n; k++)
+  {
+    double pe = 1 - m_nist->GetChunkSuccessRate (mode, txVector, std::pow (10.0, (s_snrMin + k * s_snrStep) / 10), 1);
+    table[k] = std::log (std::max (pe, 1e-300));
+  }
+
+  // The error of the interpolation is largest halfway between two points of the table
+  uint64_t nbits = s_payloadSize * 8;
+  for (int k = 0; k + 1 < n; k++)
+  {
+    double snr = std::pow (10.0, (s_snrMin + (k + 0.5) * s_snrStep) / 10);
+    s_maxError = std::max (s_maxError, std::abs (DoGetChunkSuccessRate (mode, txVector, snr, nbits)
+                                                 - m_nist->GetChunkSuccessRate (mode, txVector, snr, nbits)));
+  }
+  return table;
+}
+
+double TableErrorRateModel::DoGetChunkSuccessRate (WifiMode mode, WifiTxVector txVector, double snr, uint64_t nbits) const
+{
+  const std::vector<double>& table = GetTable (mode, txVector);
+  double u = (10 * std::log10 (snr) - s_snrMin) / s_snrStep;
+  if (!(u >= 0 && u <= table.size () - 1)) // also a null SNR
+    return m_nist->GetChunkSuccessRate (mode, txVector, snr, nbits);
+  int k = std::min ((int) u, (int) table.size () - 2);
+  u -= k;
+  double pe = std::exp ((1 - u) * table[k] + u * table[k + 1]);
+  return std::pow (1 - pe, (double) nbits);
+}
+
+
+// Propagation loss model for the links with the AP: the loss is sampled from an exact buildings model on a
+// grid at the STA height when the simulation starts (or loaded from a file) and bilinearly interpolated.
+// Links without the AP, or with a STA away from the grid, use the exact model.
+class GridBuildingsPropagationLossModel : public BuildingsPropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  void Build (Ptr<BuildingsPropagationLossModel> exact, Ptr<MobilityModel> ap,
+              double xMax, double yMax, double z, double step, std::string fileName);
+  double GetMaxError () const { return m_maxError; }
+  virtual double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
+private:
+  double Sample (double x, double y) const;
+  std::string GetSignature () const;
+  double Interpolate (Ptr<MobilityModel> a, Ptr<MobilityModel> b, Ptr<MobilityModel> sta) const;
+
+  Ptr<BuildingsPropagationLossModel> m_exact;
+  Ptr<MobilityModel> m_ap;
+  Ptr<MobilityModel> m_probe;  // STA position used to sample the exact model
+  double m_z;                  // height of the grid [m]
+  double m_dx, m_dy;           // grid steps along x and y [m]
+  int m_nx, m_ny;              // # of grid points along x and y
+  std::vector<double> m_loss;  // loss [dB] at (ix*dx, iy*dy), index ix*ny+iy
+  double m_maxError;           // max error at the centers of the cells [dB]
+};
+
+NS_OBJECT_ENSURE_REGISTERED (GridBuildingsPropagationLossModel);
+
+TypeId GridBuildingsPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("GridBuildingsPropagationLossModel")
+    .SetParent<BuildingsPropagationLossModel> ()
+    .AddConstructor<GridBuildingsPropagationLossModel> ();
+  return tid;
+}
+
+// function to describe what the samples of the grid depend on, besides its points: the type and attributes
+// of the exact model, the position of the AP and the buildings
+std::string GridBuildingsPropagationLossModel::GetSignature () const
+{
+  std::ostringstream signature;
+  signature.precision (17);
+  TypeId tid = m_exact->GetInstanceTypeId ();
+  signature << tid.GetName ();
+  for (TypeId t = tid; ; t = t.GetParent ())
+  {
+    for (uint32_t k = 0; k < t.GetAttributeN (); k++)
+    {
+      TypeId::AttributeInformation info = t.GetAttribute (k);
+      // Pointers are skipped, their values are addresses
+      std::string valueType = info.checker->GetValueTypeName ();
+      if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ()
+          || valueType == "ns3::PointerValue" || valueType == "ns3::ObjectPtrContainerValue")
+        continue;
+      Ptr<AttributeValue> value = info.checker->Create ();
+      m_exact->GetAttribute (info.name, *value);
+      signature << ";" << info.name << "=" << value->SerializeToString (info.checker);
+    }
+    if (t == t.GetParent ())
+      break;
+  }
+  Vector ap = m_ap->GetPosition ();
+  signature << ";ap=" << ap.x << "," << ap.y << "," << ap.z;
+  for (BuildingList::Iterator it = BuildingList::Begin (); it != BuildingList::End (); ++it)
+  {
+    Box box = (*it)->GetBoundaries ();
+    signature << ";building=" << box.xMin << "," << box.xMax << "," << box.yMin << "," << box.yMax << ","
+              << box.zMin << "," << box.zMax << "," << (*it)->GetNFloors () << "," << (*it)->GetNRoomsX () << ","
+              << (*it)->GetNRoomsY () << "," << (*it)->GetBuildingType () << "," << (*it)->GetExtWallsType ();
+  }
+  std::ostringstream hash;
+  hash << std::hex << std::hash<std::string> () (signature.str ());
+  return hash.str ();
+}
+
+// function to fill the grid over [0, xMax] x [0, yMax] at height z, with steps of at most step, from fileName
+// if it was written by a previous run with the same grid and the same signature (exact model, AP and buildings),
+// by sampling the exact model otherwise
+void GridBuildingsPropagationLossModel::Build (Ptr<BuildingsPropagationLossModel> exact, Ptr<MobilityModel> ap,
+                                               double xMax, double yMax, double z, double step, std::string fileName)
+{
+  m_exact = exact;
+  m_ap = ap;
+  m_z = z;
+  m_nx = (int) std::ceil (xMax / step) + 1;
+  m_ny = (int) std::ceil (yMax / step) + 1;
+  m_dx = xMax / (m_nx - 1);
+  m_dy = yMax / (m_ny - 1);
+  m_probe = CreateObject<ConstantPositionMobilityModel> ();
+  m_probe->AggregateObject (CreateObject<MobilityBuildingInfo> ());
+
+  std::string signature = GetSignature ();
+  std::ifstream in (fileName.c_str ());
+  int nx = 0, ny = 0;
+  double fileZ = 0, dx = 0, dy = 0;
+  std::string fileSignature;
+  if (fileName != "" && in >> nx >> ny >> fileZ >> dx >> dy >> fileSignature && nx == m_nx && ny == m_ny
+      && std::abs (fileZ - z) < 1e-9 && std::abs (dx - m_dx) < 1e-9 && std::abs (dy - m_dy) < 1e-9
+      && fileSignature == signature)
+  {
+    m_loss.resize (m_nx * m_ny);
+    for (int k = 0; k < m_nx * m_ny; k++)
+      in >> m_loss[k];
+  }
+  else
+  {
+    m_loss.resize (m_nx * m_ny);
+    for (int ix = 0; ix < m_nx; ix++)
+      for (int iy = 0; iy < m_ny; iy++)
+        m_loss[ix * m_ny + iy] = Sample (ix * m_dx, iy * m_dy);
+    if (fileName != "")
+    {
+      std::ofstream out (fileName.c_str ());
+      out.precision (17);
+      out << m_nx << " " << m_ny << " " << z << " " << m_dx << " " << m_dy << " " << signature << std::endl;
+      for (int k = 0; k < m_nx * m_ny; k++)
+        out << m_loss[k] << std::endl;
+    }
+  }
+
+  // The error of a bilinear interpolation is largest at the centers of the cells
+  m_maxError = 0;
+  for (int ix = 0; ix + 1 < m_nx; ix++)
+    for (int iy = 0; iy + 1 < m_ny; iy++)
+    {
+      double x = (ix + 0.5) * m_dx, y = (iy + 0.5) * m_dy;
+      m_probe->SetPosition (Vector (x, y, z));
+      BuildingsHelper::MakeConsistent (m_probe);
+      m_maxError = std::max (m_maxError, std::abs (Interpolate (m_ap, m_probe, m_probe) - Sample (x, y)));
+    }
+}
+
+// function to compute the exact loss between the AP and a STA at (x, y, m_z)
+double GridBuildingsPropagationLossModel::Sample (double x, double y) const
+{
+  m_probe->SetPosition (Vector (x, y, m_z));
+  BuildingsHelper::MakeConsistent (m_probe);
+  return m_exact->GetLoss (m_probe, m_ap);
+}
+
+double GridBuildingsPropagationLossModel::Interpolate (Ptr<MobilityModel> a, Ptr<MobilityModel> b,
+                                                       Ptr<MobilityModel> sta) const
+{
+  Vector position = sta->GetPosition ();
+  double u = position.x / m_dx, v = position.y / m_dy;
+  if (std::abs (position.z - m_z) > 1e-6 || u < 0 || v < 0 || u > m_nx - 1 || v > m_ny - 1)
+    return m_exact->GetLoss (a, b);
+  int ix = std::min ((int) u, m_nx - 2), iy = std::min ((int) v, m_ny - 2);
+  u -= ix;
+  v -= iy;
+  const double* column = &m_loss[ix * m_ny + iy];
+  return (1 - u) * ((1 - v) * column[0] + v * column[1]) + u * ((1 - v) * column[m_ny] + v * column[m_ny + 1]);
+}
+
+double GridBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  if (a == m_ap)
+    return Interpolate (a, b, b);
+  if (b == m_ap)
+    return Interpolate (a, b, a);
+  return m_exact->GetLoss (a, b);
+}
+
+} // namespace ns3
+
+#endif /* WIFI_MODELS_H */
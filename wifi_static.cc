@@ -63,6 +63,9 @@
 #include "ns3/netanim-module.h"
 #include "ns3/buildings-module.h"
 #include "ns3/ipv4-flow-classifier.h"
+#include <unistd.h>
+#include <sys/wait.h>
+#include "seed_pool.h"
 
 
 #define ENDC    "\033[0m"
@@ -158,6 +161,9 @@ int main (int argc, char *argv[])
   uint32_t payloadSize = 1472;          // bytes (UDP)
   double simulationTime = 15;           // seconds
   int seed = 1;                         // seed used in the simulation
+  int lastSeed = 0;                     // last seed of a batch (0 = only seed)
+  int jobs = 1;                         // seeds of a batch run at the same time
+  bool keepShards = 0;                  // 1 leaves the shard of each seed unmerged
   std::string csvFileName = "test.csv"; // csv file name
   std::string band = "AX_5";            // AC_5, AX_2.4 or AX_5
   std::string phyModel = "spectrum";    // "spectrum" or "yans"
@@ -169,6 +175,12 @@ int main (int argc, char *argv[])
   int nStaA = 1;                        // number of stations A
   int nStaB = 1;                        // number of stations B
   int nStaC = 1;                        // number of stations C
+  int dataRateMinA = 80;                // data rate A drawn in [min, max) Mb/s
+  int dataRateMaxA = 101;
+  int dataRateMinB = 30;                // data rate B drawn in [min, max) Kb/s
+  int dataRateMaxB = 51;
+  int dataRateMinC = 20;                // data rate C drawn in [min, max) Mb/s
+  int dataRateMaxC = 41;
   // Network A
   int channelNumberA = 42;  // channel number A
   int channelWidthA = 20;   // 20, 40, 80 or 160 MHz
@@ -195,6 +207,9 @@ int main (int argc, char *argv[])
   cmd.AddValue ("payloadSize", "Payload size in bytes", payloadSize);
   cmd.AddValue ("simulationTime", "Simulation time in seconds", simulationTime);
   cmd.AddValue ("seed", "Seed", seed);
+  cmd.AddValue ("lastSeed", "Run the seeds seed, ..., lastSeed in a batch", lastSeed);
+  cmd.AddValue ("jobs", "Number of seeds of a batch run in parallel", jobs);
+  cmd.AddValue ("keepShards", "Write one shard per seed and do not merge them", keepShards);
   cmd.AddValue ("csvFileName", "Name of the .csv file", csvFileName);
   cmd.AddValue ("band", "AC_5, AX_2.4 or AX_5", band);
   cmd.AddValue ("phyModel", "PHY layer model", phyModel);
@@ -203,6 +218,12 @@ int main (int argc, char *argv[])
   cmd.AddValue ("nStaA", "Number Stations A", nStaA);
   cmd.AddValue ("nStaB", "Number Stations B", nStaB);
   cmd.AddValue ("nStaC", "Number Stations C", nStaC);
+  cmd.AddValue ("dataRateMinA", "Minimum data rate A [Mb/s]", dataRateMinA);
+  cmd.AddValue ("dataRateMaxA", "Maximum data rate A (excluded) [Mb/s]", dataRateMaxA);
+  cmd.AddValue ("dataRateMinB", "Minimum data rate B [Kb/s]", dataRateMinB);
+  cmd.AddValue ("dataRateMaxB", "Maximum data rate B (excluded) [Kb/s]", dataRateMaxB);
+  cmd.AddValue ("dataRateMinC", "Minimum data rate C [Mb/s]", dataRateMinC);
+  cmd.AddValue ("dataRateMaxC", "Maximum data rate C (excluded) [Mb/s]", dataRateMaxC);
   // Network A
   cmd.AddValue ("channelNumberA", "Channel number A", channelNumberA);
   cmd.AddValue ("channelWidthA", "Channel width A", channelWidthA);
@@ -226,14 +247,20 @@ int main (int argc, char *argv[])
   cmd.AddValue ("dataRateC_old", "Data rate C", dataRateC_old);
 
   cmd.Parse (argc, argv);
+  if (lastSeed > seed || keepShards)
+  {
+    int failed = fork_seeds (seed, lastSeed, jobs, keepShards, {{&csvFileName, 0}});
+    if (failed >= 0)
+      return failed > 0;
+  }
 
   // Set the PRNG seed
   RngSeedManager::SetSeed (seed);
 
   // Set random throughput for each flow in the the 3 slices
   Ptr<UniformRandomVariable> dataRateA_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateA_ptr->SetAttribute ("Min", DoubleValue (80));
-  dataRateA_ptr->SetAttribute ("Max", DoubleValue (101));
+  dataRateA_ptr->SetAttribute ("Min", DoubleValue (dataRateMinA));
+  dataRateA_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxA));
   std::vector<int> dataRateA(nStaA);
   std::vector<std::string> dataRateA_str(nStaA);
   for (int i = 0; i < nStaA; i++)
@@ -242,8 +269,8 @@ int main (int argc, char *argv[])
     dataRateA_str[i] = std::to_string(dataRateA[i]) + "Mb/s";
   }
   Ptr<UniformRandomVariable> dataRateB_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateB_ptr->SetAttribute ("Min", DoubleValue (30));
-  dataRateB_ptr->SetAttribute ("Max", DoubleValue (51));
+  dataRateB_ptr->SetAttribute ("Min", DoubleValue (dataRateMinB));
+  dataRateB_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxB));
   std::vector<int> dataRateB(nStaB);
   std::vector<std::string> dataRateB_str(nStaB);
   for (int i = 0; i < nStaB; i++)
@@ -252,8 +279,8 @@ int main (int argc, char *argv[])
     dataRateB_str[i] = std::to_string(dataRateB[i]) + "Kb/s";
   }
   Ptr<UniformRandomVariable> dataRateC_ptr = CreateObject<UniformRandomVariable> ();
-  dataRateC_ptr->SetAttribute ("Min", DoubleValue (20));
-  dataRateC_ptr->SetAttribute ("Max", DoubleValue (41));
+  dataRateC_ptr->SetAttribute ("Min", DoubleValue (dataRateMinC));
+  dataRateC_ptr->SetAttribute ("Max", DoubleValue (dataRateMaxC));
   std::vector<int> dataRateC(nStaC);
   std::vector<std::string> dataRateC_str(nStaC);
   for (int i = 0; i < nStaC; i++)
@@ -649,8 +676,11 @@ int main (int argc, char *argv[])
   Simulator::Run ();
 
   // Activate/deactivate the histograms and the per-probe detailed stats
-  std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
-  flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
+  if (jobs == 1) // parallel seeds would overwrite each other's file
+  {
+    std::cout << OKBLUE <<"Writing to file: FlowMonitorFile.xml"<< ENDC << std::endl;
+    flowMonitor->SerializeToXmlFile("FlowMonitorFile.xml", false, false);
+  }
 
   // Show results
   std::vector<uint64_t> totalPacketsRxA(nStaA), totalPacketsLossA(nStaA);